@@ -0,0 +1,97 @@
+#include <chrono>
+#include <thread>
+
+#include "audio.hpp"
+
+audio_generator::audio_generator(spsc_ring<int16_t> &ring,
+                                 unsigned sample_rate,
+                                 double cycles_per_second, when_full full,
+                                 unsigned tone_hz, int16_t amplitude)
+    : m_ring(ring), m_samples_per_cycle(sample_rate / cycles_per_second),
+      m_half_period((uint64_t{sample_rate} << 16) / (2 * tone_hz)),
+      m_amplitude(amplitude), m_full(full), m_on(false), m_sample(0),
+      m_dropped(0) {}
+
+void audio_generator::render_until(uint64_t cycle) {
+  auto target = static_cast<uint64_t>(cycle * m_samples_per_cycle);
+  while (m_sample < target) {
+    size_t count = std::min<uint64_t>(target - m_sample, m_chunk.size());
+    for (size_t i = 0; i < count; ++i) {
+      bool high = (((m_sample + i) << 16) / m_half_period) & 1;
+      m_chunk[i] = !m_on ? 0 : high ? m_amplitude : -m_amplitude;
+    }
+    size_t pushed = m_ring.push({m_chunk.data(), count});
+    while (m_full == when_full::WAIT && pushed < count) {
+      std::this_thread::yield();
+      pushed += m_ring.push({m_chunk.data() + pushed, count - pushed});
+    }
+    m_dropped += count - pushed;
+    m_sample += count;
+  }
+}
+
+static void put_le(std::ostream &os, uint32_t v, unsigned bytes) {
+  for (unsigned i = 0; i < bytes; ++i, v >>= 8) {
+    os.put(static_cast<char>(v & 0xFF));
+  }
+}
+
+static void write_wav_header(std::ostream &os, unsigned sample_rate,
+                             uint32_t data_bytes) {
+  os.write("RIFF", 4);
+  put_le(os, 36 + data_bytes, 4);
+  os.write("WAVEfmt ", 8);
+  put_le(os, 16, 4);              // fmt chunk size
+  put_le(os, 1, 2);               // PCM
+  put_le(os, 1, 2);               // mono
+  put_le(os, sample_rate, 4);     // sample rate
+  put_le(os, sample_rate * 2, 4); // byte rate
+  put_le(os, 2, 2);               // block align
+  put_le(os, 16, 2);              // bits per sample
+  os.write("data", 4);
+  put_le(os, data_bytes, 4);
+}
+
+std::unique_ptr<wav_sink> wav_sink::create(const std::string &path,
+                                           spsc_ring<int16_t> &ring,
+                                           unsigned sample_rate) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out.is_open()) {
+    return nullptr;
+  }
+  // Sizes are patched in once the sink finishes.
+  write_wav_header(out, sample_rate, 0);
+  return std::unique_ptr<wav_sink>(new wav_sink(std::move(out), ring));
+}
+
+wav_sink::wav_sink(std::ofstream out, spsc_ring<int16_t> &ring)
+    : m_out(std::move(out)), m_ring(ring), m_stop(false), m_samples(0),
+      m_thread([this] { run(); }) {}
+
+wav_sink::~wav_sink() {
+  m_stop.store(true, std::memory_order_release);
+  m_thread.join();
+
+  uint32_t data_bytes = m_samples * 2;
+  m_out.seekp(4);
+  put_le(m_out, 36 + data_bytes, 4);
+  m_out.seekp(40);
+  put_le(m_out, data_bytes, 4);
+}
+
+void wav_sink::run() {
+  std::array<int16_t, 4096> chunk;
+  for (;;) {
+    bool stopping = m_stop.load(std::memory_order_acquire);
+    size_t count = m_ring.pop(chunk);
+    if (count) {
+      // WAV is little-endian, like every host we build for.
+      m_out.write(reinterpret_cast<const char *>(chunk.data()), count * 2);
+      m_samples += count;
+    } else if (stopping) {
+      return;
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+}
@@ -0,0 +1,94 @@
+#ifndef SWIMP_AUDIO_H
+#define SWIMP_AUDIO_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "spsc_ring.hpp"
+
+/**
+ * Turns sound timer activity into a square wave.
+ *
+ * The generator runs on the emulation thread. It notes the guest cycle at
+ * which ST becomes zero or non-zero and renders samples up to that cycle, so
+ * the tone starts and stops on the exact instruction regardless of how the
+ * host batches steps. Samples go into a ring that a sink drains on another
+ * thread. If the sink falls behind, a real-time player drops samples rather
+ * than stalling emulation, while an offline one such as wav_sink waits.
+ */
+class audio_generator {
+public:
+  /// What to do with samples that don't fit in the ring.
+  enum class when_full {
+    DROP,
+    /// Wait for the sink to make room; something must be draining the ring.
+    WAIT,
+  };
+
+  /**
+   * @param cycles_per_second Guest instructions per second of real time.
+   */
+  audio_generator(spsc_ring<int16_t> &ring, unsigned sample_rate,
+                  double cycles_per_second, when_full full = when_full::DROP,
+                  unsigned tone_hz = 440, int16_t amplitude = 8000);
+
+  /// Call after every step.
+  template <class Machine> inline void observe(const Machine &mach) {
+    bool on = mach.reg_ST() > 0;
+    if (on != m_on) [[unlikely]] {
+      render_until(mach.cycles());
+      m_on = on;
+    }
+  }
+
+  /// Renders all samples up to (not including) the given cycle. Call at least
+  /// once per frame.
+  void render_until(uint64_t cycle);
+
+  inline uint64_t dropped() const { return m_dropped; };
+
+private:
+  spsc_ring<int16_t> &m_ring;
+  double m_samples_per_cycle;
+  /// Samples per half period of the tone, in 1/65536ths.
+  uint64_t m_half_period;
+  int16_t m_amplitude;
+  when_full m_full;
+  bool m_on;
+  uint64_t m_sample;
+  uint64_t m_dropped;
+  std::array<int16_t, 512> m_chunk;
+};
+
+/// Drains a ring into a 16-bit mono WAV file on a background thread.
+class wav_sink {
+public:
+  /// Returns nullptr if the file cannot be created.
+  static std::unique_ptr<wav_sink> create(const std::string &path,
+                                          spsc_ring<int16_t> &ring,
+                                          unsigned sample_rate);
+
+  wav_sink(const wav_sink &) = delete;
+  wav_sink &operator=(const wav_sink &) = delete;
+
+  /// Drains whatever is left, then finishes the file.
+  ~wav_sink();
+
+private:
+  wav_sink(std::ofstream out, spsc_ring<int16_t> &ring);
+
+  void run();
+
+  std::ofstream m_out;
+  spsc_ring<int16_t> &m_ring;
+  std::atomic<bool> m_stop;
+  uint64_t m_samples;
+  std::thread m_thread;
+};
+
+#endif // SWIMP_AUDIO_H
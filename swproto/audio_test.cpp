@@ -0,0 +1,77 @@
+#include <cstdlib>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "audio.hpp"
+
+/// Just what audio_generator::observe() looks at.
+struct fake_machine {
+  uint8_t st = 0;
+  uint64_t cycle = 0;
+
+  uint8_t reg_ST() const { return st; }
+  uint64_t cycles() const { return cycle; }
+};
+
+TEST(AudioTest, TestToneFollowsSoundTimer) {
+  // 10 samples per cycle and a tone with 5-sample half periods.
+  spsc_ring<int16_t> ring(1024);
+  audio_generator audio(ring, 1000, 100, audio_generator::when_full::DROP,
+                        100, 1000);
+  fake_machine mach;
+  mach.cycle = 10;
+  mach.st = 5;
+  audio.observe(mach);
+  mach.cycle = 20;
+  mach.st = 0;
+  audio.observe(mach);
+  audio.render_until(30);
+
+  std::vector<int16_t> samples(1024);
+  samples.resize(ring.pop(samples));
+  ASSERT_EQ(samples.size(), 300);
+  for (size_t i = 0; i < samples.size(); ++i) {
+    if (i < 100 || i >= 200) {
+      ASSERT_EQ(samples[i], 0) << "sample " << i;
+    } else {
+      ASSERT_EQ(samples[i], (i / 5) % 2 ? 1000 : -1000) << "sample " << i;
+    }
+  }
+  ASSERT_EQ(audio.dropped(), 0);
+}
+
+TEST(AudioTest, TestWavSinkKeepsEverySample) {
+  const unsigned sample_rate = 44100;
+  const unsigned cycles_per_second = 700;
+  const uint64_t cycles = 14000;
+  std::string path = ::testing::TempDir() + "audio_test.wav";
+  {
+    // A ring far smaller than the output makes the generator wait.
+    spsc_ring<int16_t> ring(4096);
+    auto sink = wav_sink::create(path, ring, sample_rate);
+    ASSERT_NE(sink, nullptr);
+    audio_generator audio(ring, sample_rate, cycles_per_second,
+                          audio_generator::when_full::WAIT);
+    fake_machine mach;
+    for (mach.cycle = 0; mach.cycle < cycles; mach.cycle += 100) {
+      mach.st = (mach.cycle / 1000) % 2 ? 10 : 0;
+      audio.observe(mach);
+    }
+    audio.render_until(cycles);
+    ASSERT_EQ(audio.dropped(), 0);
+  }
+
+  std::ifstream in(path, std::ios::binary);
+  std::vector<char> bytes((std::istreambuf_iterator<char>(in)),
+                          std::istreambuf_iterator<char>());
+  ASSERT_GE(bytes.size(), 44);
+  uint32_t data_bytes = 0;
+  for (int i = 3; i >= 0; --i) {
+    data_bytes = (data_bytes << 8) | static_cast<uint8_t>(bytes[40 + i]);
+  }
+  uint64_t expected = cycles * sample_rate / cycles_per_second;
+  ASSERT_EQ(data_bytes, expected * 2);
+  ASSERT_EQ(bytes.size(), 44 + expected * 2);
+  std::remove(path.c_str());
+}
@@ -0,0 +1,39 @@
+#ifndef SWIMP_BOOT_H
+#define SWIMP_BOOT_H
+
+#include <cstdint>
+
+#include "statemachine.hpp"
+
+/**
+ * Runs a machine for as long as its behaviour can't depend on the outside
+ * world, so that the result can be computed at compile time:
+ *
+ *   constexpr auto booted = run_boot_sequence(statemachine(*rom, conf), N);
+ *
+ * Stops in front of the first instruction that reads keys (Ex9E, ExA1, Fx0A)
+ * or random numbers (Cxkk), on any status other than NO_ERROR, or once the
+ * machine has run max_cycles. The returned machine resumes exactly where an
+ * unbooted one would have been at that point.
+ */
+template <class Machine>
+constexpr Machine run_boot_sequence(Machine mach, uint64_t max_cycles) {
+  const auto &mem = mach.backing_memory();
+  while (mach.cycles() < max_cycles) {
+    uint16_t pc = mach.pc();
+    uint8_t hi = mem.read(pc & Machine::ADDRESS_MASK);
+    uint8_t lo = mem.read((pc + 1) & Machine::ADDRESS_MASK);
+    bool reads_keys = (hi >> 4) == 0xE || ((hi >> 4) == 0xF && lo == 0x0A);
+    if (reads_keys || (hi >> 4) == 0xC) {
+      break;
+    }
+    // Fused sequences never contain Cxkk or key reads, so stepping can't run
+    // past one.
+    if (mach.step(0) != statemachine_common::NO_ERROR) {
+      break;
+    }
+  }
+  return mach;
+}
+
+#endif // SWIMP_BOOT_H
@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "chip8.h"
+#include "rom.hpp"
+#include "statemachine.hpp"
+
+constexpr static uint32_t MAX_REWARD_ADDRESSES = 64;
+
+struct chip8_pool {
+  statemachine initial;
+  std::vector<statemachine> machines;
+  std::vector<uint8_t> done;
+  std::vector<uint16_t> reward_addresses;
+  uint32_t cycles_per_frame;
+};
+
+uint32_t chip8_abi_version(void) { return CHIP8_ABI_VERSION; }
+
+uint32_t chip8_display_width(void) { return statemachine::DISPLAY_WIDTH; }
+
+uint32_t chip8_display_height(void) {
+  return statemachine::DISPLAY_HEIGHT;
+}
+
+uint32_t chip8_display_size(void) { return statemachine::DISPLAY_SIZE; }
+
+chip8_pool *chip8_pool_create(const uint8_t *rom, size_t rom_size,
+                              uint32_t count, uint32_t cycles_per_frame,
+                              uint32_t flags) {
+  auto image = load_rom({rom, rom_size});
+  if (!image || count == 0 || cycles_per_frame == 0) {
+    return nullptr;
+  }
+  // No exception may cross into the caller's language.
+  try {
+    statemachine initial(*image,
+                         {
+                             .pc = statemachine::PROG_BEGIN,
+                             .font_begin = 0x000,
+                             .cycles_per_tick = cycles_per_frame,
+                             .quirk_shift = !!(flags & CHIP8_QUIRK_SHIFT),
+                             .quirk_load_store =
+                                 !!(flags & CHIP8_QUIRK_LOAD_STORE),
+                             .fuse_instructions = !(flags & CHIP8_NO_FUSION),
+                         });
+    // Each machine owns its memory outright, so neither stepping nor
+    // resetting ever allocates.
+    auto pool = std::unique_ptr<chip8_pool>(new chip8_pool{
+        .initial = initial,
+        .machines = std::vector<statemachine>(count, initial),
+        .done = std::vector<uint8_t>(count, 0),
+        .reward_addresses = {},
+        .cycles_per_frame = cycles_per_frame,
+    });
+    // So that chip8_pool_set_reward_addresses never allocates.
+    pool->reward_addresses.reserve(MAX_REWARD_ADDRESSES);
+    return pool.release();
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void chip8_pool_destroy(chip8_pool *pool) { delete pool; }
+
+uint32_t chip8_pool_size(const chip8_pool *pool) {
+  return pool->machines.size();
+}
+
+int chip8_pool_set_reward_addresses(chip8_pool *pool,
+                                    const uint16_t *addresses,
+                                    uint32_t count) {
+  if (count > MAX_REWARD_ADDRESSES) {
+    return -1;
+  }
+  pool->reward_addresses.assign(addresses, addresses + count);
+  for (auto &addr : pool->reward_addresses) {
+    addr &= statemachine::ADDRESS_MASK;
+  }
+  return 0;
+}
+
+void chip8_pool_reset(chip8_pool *pool, uint32_t index) {
+  if (index < pool->machines.size()) {
+    try {
+      pool->machines[index] = pool->initial;
+      pool->done[index] = 0;
+    } catch (...) {
+      pool->done[index] = 1;
+    }
+  }
+}
+
+uint32_t chip8_batch_step(chip8_pool *pool, const uint16_t *keys,
+                          uint32_t frames, uint8_t *displays,
+                          uint8_t *rewards, uint8_t *done) {
+  uint64_t budget = uint64_t{frames} * pool->cycles_per_frame;
+  size_t reward_count = pool->reward_addresses.size();
+  uint32_t done_count = 0;
+
+  for (size_t i = 0; i < pool->machines.size(); ++i) {
+    auto &mach = pool->machines[i];
+    uint16_t keystate = keys ? keys[i] : 0;
+    // Frames always end on multiples of cycles_per_frame, even after a fused
+    // step overran the previous one.
+    uint64_t end = (mach.cycles() / pool->cycles_per_frame) *
+                       pool->cycles_per_frame +
+                   budget;
+    // No exception may reach the caller; a machine that throws is done.
+    try {
+      while (!pool->done[i] && mach.cycles() < end) {
+        auto status = mach.step(keystate);
+        if (status == statemachine_common::WAITING_FOR_KEYPRESS) {
+          // The keys can't change before the call returns.
+          mach.idle_until(end);
+        } else if (status < 0) {
+          pool->done[i] = 1;
+        }
+      }
+    } catch (...) {
+      pool->done[i] = 1;
+    }
+
+    done_count += pool->done[i];
+    if (displays) {
+      auto display = mach.display();
+      std::copy(display.begin(), display.end(),
+                displays + i * statemachine::DISPLAY_SIZE);
+    }
+    if (rewards) {
+      const auto &mem = mach.backing_memory();
+      for (size_t r = 0; r < reward_count; ++r) {
+        rewards[i * reward_count + r] =
+            mem.read(pool->reward_addresses[r]);
+      }
+    }
+    if (done) {
+      done[i] = pool->done[i];
+    }
+  }
+  return done_count;
+}
+
+void chip8_pool_state_hashes(const chip8_pool *pool, uint64_t *hashes) {
+  for (size_t i = 0; i < pool->machines.size(); ++i) {
+    hashes[i] = pool->machines[i].state_hash();
+  }
+}
@@ -0,0 +1,97 @@
+#ifndef SWIMP_CHIP8_H
+#define SWIMP_CHIP8_H
+
+/*
+ * Plain C interface to a pool of CHIP-8 machines, meant for driving many
+ * environments at once from other languages. All machines in a pool run the
+ * same ROM, and each holds its own 4 KiB of memory.
+ *
+ * Nothing here allocates or throws after chip8_pool_create(): results are
+ * written into buffers the caller owns and typically reuses across calls.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define CHIP8_API __attribute__((visibility("default")))
+#else
+#define CHIP8_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Bumped whenever a signature or struct in this header changes. */
+#define CHIP8_ABI_VERSION 1
+
+/* Flags for chip8_pool_create. */
+#define CHIP8_QUIRK_SHIFT 0x1u
+#define CHIP8_QUIRK_LOAD_STORE 0x2u
+#define CHIP8_NO_FUSION 0x4u
+
+typedef struct chip8_pool chip8_pool;
+
+CHIP8_API uint32_t chip8_abi_version(void);
+
+/** Display width and height in pixels, and packed 1bpp size in bytes. */
+CHIP8_API uint32_t chip8_display_width(void);
+CHIP8_API uint32_t chip8_display_height(void);
+CHIP8_API uint32_t chip8_display_size(void);
+
+/**
+ * Creates `count` machines running `rom`, which is loaded at 0x200. Each
+ * frame is `cycles_per_frame` instructions long, and the timers tick once
+ * per frame. Returns NULL if the ROM doesn't fit, count or cycles_per_frame
+ * is 0, or memory runs out.
+ */
+CHIP8_API chip8_pool *chip8_pool_create(const uint8_t *rom, size_t rom_size,
+                                        uint32_t count,
+                                        uint32_t cycles_per_frame,
+                                        uint32_t flags);
+
+CHIP8_API void chip8_pool_destroy(chip8_pool *pool);
+
+CHIP8_API uint32_t chip8_pool_size(const chip8_pool *pool);
+
+/**
+ * Sets the memory addresses whose bytes chip8_batch_step reports as rewards,
+ * e.g. where a game keeps its score. Returns 0, or -1 if count exceeds 64.
+ */
+CHIP8_API int chip8_pool_set_reward_addresses(chip8_pool *pool,
+                                              const uint16_t *addresses,
+                                              uint32_t count);
+
+/** Returns machine `index` to its initial state and clears its done flag. */
+CHIP8_API void chip8_pool_reset(chip8_pool *pool, uint32_t index);
+
+/**
+ * Runs every machine that isn't done for `frames` frames, machine i seeing
+ * keystate keys[i]. A machine is done once it reports an error.
+ *
+ * Any output pointer may be NULL. Otherwise, for N machines and R reward
+ * addresses:
+ *   displays  N * chip8_display_size() bytes, machine-major
+ *   rewards   N * R bytes, machine-major
+ *   done      N bytes, 1 for machines that are done
+ *
+ * Returns the number of machines that are done.
+ */
+CHIP8_API uint32_t chip8_batch_step(chip8_pool *pool, const uint16_t *keys,
+                                    uint32_t frames, uint8_t *displays,
+                                    uint8_t *rewards, uint8_t *done);
+
+/**
+ * Writes a 64-bit fingerprint of each machine's state into `hashes`, which
+ * holds one entry per machine. Machines in the same state have the same
+ * fingerprint however they got there; this is O(1) per machine.
+ */
+CHIP8_API void chip8_pool_state_hashes(const chip8_pool *pool,
+                                       uint64_t *hashes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SWIMP_CHIP8_H */
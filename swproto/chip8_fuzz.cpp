@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <span>
+
+#include "rom.hpp"
+#include "statemachine.hpp"
+
+/*
+ * libFuzzer target for the interpreter. An input is
+ *
+ *   u8 n, then n schedule entries of {u8 frame, u16 keystate}, then the ROM
+ *
+ * with integers little-endian. The ROM runs for at most MAX_FRAMES frames,
+ * holding the keystate of the latest entry whose frame has been reached.
+ *
+ * Every run starts from a copy of one prepared machine with only the ROM
+ * poked in, so an iteration costs a copy of the machine plus the cycles it
+ * runs. Crashes, sanitizer reports and exceptions from .at() are reported by
+ * libFuzzer. Every status other than NO_ERROR is counted, and the counts are
+ * printed when the fuzzer exits; a negative status ends the run.
+ */
+
+const static unsigned CYCLES_PER_FRAME = 700 / 60;
+const static unsigned MAX_FRAMES = 64;
+const static unsigned MAX_SCHEDULE = 16;
+
+namespace {
+
+/// How often each status was returned, printed when the fuzzer exits.
+struct status_counts {
+  ~status_counts() {
+    std::cerr << "chip8_fuzz: " << runs << " runs, " << budget_exhausted
+              << " used the whole budget\n";
+    for (unsigned i = 0; i < counts.size(); ++i) {
+      if (counts[i]) {
+        std::cerr << "  status " << static_cast<int>(static_cast<int8_t>(i))
+                  << ": " << counts[i] << "\n";
+      }
+    }
+  }
+
+  uint64_t runs = 0;
+  uint64_t budget_exhausted = 0;
+  /// Indexed by the status as an int8_t.
+  std::array<uint64_t, 256> counts{};
+};
+
+status_counts stats;
+
+const statemachine &prepared_machine() {
+  const static statemachine mach(*load_rom({}),
+                                 {
+                                     .pc = statemachine::PROG_BEGIN,
+                                     .font_begin = 0x000,
+                                     .cycles_per_tick = CYCLES_PER_FRAME,
+                                     .fuse_instructions = true,
+                                 });
+  return mach;
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (size < 1) {
+    return -1;
+  }
+  std::span<const uint8_t> input(data, size);
+  size_t entries = std::min<size_t>(input[0], MAX_SCHEDULE);
+  if (input.size() < 1 + 3 * entries) {
+    return -1;
+  }
+  auto schedule = input.subspan(1, 3 * entries);
+  auto rom = input.subspan(1 + 3 * entries);
+  if (rom.size() > statemachine::MEMORY_SIZE - statemachine::PROG_BEGIN) {
+    return -1;
+  }
+
+  // The prepared machine's program area is all zeros, so poking the ROM in
+  // is the same as loading it from scratch.
+  static statemachine mach = prepared_machine();
+  mach = prepared_machine();
+  mach.poke(statemachine::PROG_BEGIN, rom);
+
+  ++stats.runs;
+  uint16_t keystate = 0;
+  size_t next_entry = 0;
+  for (unsigned frame = 0; frame < MAX_FRAMES; ++frame) {
+    while (next_entry < entries && schedule[3 * next_entry] <= frame) {
+      keystate = schedule[3 * next_entry + 1] |
+                 (schedule[3 * next_entry + 2] << 8);
+      ++next_entry;
+    }
+
+    uint64_t frame_end = (frame + 1) * CYCLES_PER_FRAME;
+    while (mach.cycles() < frame_end) {
+      auto status = mach.step(keystate);
+      if (status == statemachine_common::WAITING_FOR_KEYPRESS) {
+        mach.idle_until(frame_end);
+      } else if (status != statemachine_common::NO_ERROR) {
+        ++stats.counts[static_cast<uint8_t>(status)];
+        if (status < 0) {
+          return 0;
+        }
+      }
+    }
+  }
+  ++stats.budget_exhausted;
+  return 0;
+}
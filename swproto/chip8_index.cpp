@@ -0,0 +1,17 @@
+#include <iostream>
+
+#include "log.hpp"
+#include "rom_library.hpp"
+
+/// Builds a ROM library index for the emulator's and headless' --library.
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " <ROM directory> <index file>\n";
+    return 1;
+  }
+  if (!build_rom_index(argv[1], argv[2])) {
+    return 1;
+  }
+  auto library = rom_library::open(argv[2]);
+  return library ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "log.hpp"
+#include "rom.hpp"
+#include "search.hpp"
+#include "video.hpp"
+
+/// Parses a comma-separated list of hex numbers.
+static std::optional<std::vector<uint16_t>> parse_hex_list(const char *text) {
+  std::vector<uint16_t> ret;
+  for (char *end;; text = end + 1) {
+    ret.push_back(strtoul(text, &end, 16));
+    if (end == text || (*end != ',' && *end != '\0')) {
+      return std::nullopt;
+    }
+    if (*end == '\0') {
+      return ret;
+    }
+  }
+}
+
+/// Searches for the keystates that maximize a score kept in memory, then
+/// optionally records the best line of play.
+int main(int argc, char **argv) {
+  using namespace std;
+
+  search_config conf{.threads = max(thread::hardware_concurrency(), 1u)};
+  string path;
+  optional<string> record_path;
+  bool fuse = true;
+  for (int i = 1; i < argc; ++i) {
+    string_view arg = argv[i];
+    const char *value = argv[i] + arg.find('=') + 1;
+    optional<vector<uint16_t>> list;
+    if (arg.starts_with("--score=") && (list = parse_hex_list(value))) {
+      conf.score_addresses = *list;
+    } else if (arg.starts_with("--actions=") &&
+               (list = parse_hex_list(value))) {
+      conf.actions = *list;
+    } else if (arg.starts_with("--expansions=")) {
+      conf.max_expansions = strtoul(value, nullptr, 10);
+    } else if (arg.starts_with("--frames-per-action=")) {
+      conf.frames_per_action = strtoul(value, nullptr, 10);
+    } else if (arg.starts_with("--threads=")) {
+      conf.threads = strtoul(value, nullptr, 10);
+    } else if (arg.starts_with("--record=")) {
+      record_path = value;
+    } else if (arg == "--no-fusion") {
+      fuse = false;
+    } else if (!arg.starts_with("--") && path.empty()) {
+      path = arg;
+    } else {
+      path.clear();
+      break;
+    }
+  }
+
+  if (path.empty() || conf.score_addresses.empty()) {
+    std::cerr << "Usage: " << argv[0]
+              << " --score=<hex addr>[,...] [--actions=<hex keystate>,...]"
+                 " [--expansions=<count>] [--frames-per-action=<count>]"
+                 " [--threads=<count>] [--record=<file>] [--no-fusion]"
+                 " <ROM.ch8>\n";
+    return 1;
+  }
+  if (conf.actions.empty()) {
+    // No keys, or any single key.
+    conf.actions.push_back(0);
+    for (unsigned key = 0; key < 16; ++key) {
+      conf.actions.push_back(1u << key);
+    }
+  }
+
+  auto possible_mem = try_load(path);
+  if (!possible_mem.has_value()) {
+    LOG_ERROR("Failed to open {}", path);
+    return 1;
+  }
+  cow_statemachine root(
+      make_shared<const rom_image<cow_statemachine::MEMORY_SIZE>>(
+          *possible_mem),
+      {
+          .pc = cow_statemachine::PROG_BEGIN,
+          .font_begin = 0x000,
+          .cycles_per_tick = conf.cycles_per_frame,
+          .fuse_instructions = fuse,
+      });
+
+  auto start = chrono::steady_clock::now();
+  auto result = best_first_search(root, conf);
+  double seconds =
+      chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  LOG_INFO("Expanded {} nodes in {}s on {} threads ({} nodes/s)",
+           result.expanded, seconds, conf.threads,
+           static_cast<uint64_t>(result.expanded / max(seconds, 1e-9)));
+  LOG_INFO("Dropped {} transpositions and {} dead ends",
+           result.transpositions, result.dead_ends);
+  LOG_INFO("Best score {} after {} actions", result.score,
+           result.actions.size());
+
+  for (uint16_t action : result.actions) {
+    std::cout << hex << action << '\n';
+  }
+
+  if (record_path) {
+    auto recorder = video_writer::create(*record_path,
+                                         cow_statemachine::DISPLAY_WIDTH,
+                                         cow_statemachine::DISPLAY_HEIGHT);
+    if (!recorder) {
+      LOG_ERROR("Failed to create {}", *record_path);
+      return 1;
+    }
+    cow_statemachine mach = root;
+    uint64_t frame_end = 0;
+    for (uint16_t action : result.actions) {
+      for (unsigned f = 0; f < conf.frames_per_action; ++f) {
+        frame_end += conf.cycles_per_frame;
+        while (mach.cycles() < frame_end) {
+          auto status = mach.step(action);
+          if (status == statemachine_common::WAITING_FOR_KEYPRESS) {
+            mach.idle_until(frame_end);
+          } else if (status < 0) {
+            // The search never keeps a line that fails.
+            return 1;
+          }
+        }
+        recorder->write_frame(mach.display());
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,72 @@
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "game_server.hpp"
+#include "log.hpp"
+#include "rom.hpp"
+
+/// Serves one ROM to any number of clients until SIGINT or SIGTERM.
+int main(int argc, char **argv) {
+  using namespace std;
+
+  game_server::config conf;
+  string rom_path;
+  for (int i = 1; i < argc; ++i) {
+    string_view arg = argv[i];
+    if (arg.starts_with("--workers=")) {
+      conf.workers = strtoul(argv[i] + arg.find('=') + 1, nullptr, 10);
+    } else if (arg.starts_with("--max-sessions=")) {
+      conf.max_sessions = strtoul(argv[i] + arg.find('=') + 1, nullptr, 10);
+    } else if (arg.starts_with("--send-buffer=")) {
+      conf.send_buffer = strtol(argv[i] + arg.find('=') + 1, nullptr, 10);
+    } else if (arg == "--no-fusion") {
+      conf.fuse_instructions = false;
+    } else if (!arg.starts_with("--") && conf.socket_path.empty()) {
+      conf.socket_path = arg;
+    } else if (!arg.starts_with("--") && rom_path.empty()) {
+      rom_path = arg;
+    } else {
+      rom_path.clear();
+      break;
+    }
+  }
+
+  if (rom_path.empty()) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--workers=<count>] [--max-sessions=<count>]"
+                 " [--send-buffer=<bytes>] [--no-fusion] <socket path>"
+                 " <ROM.ch8>\n";
+    return 1;
+  }
+
+  auto possible_mem = try_load(rom_path);
+  if (!possible_mem.has_value()) {
+    LOG_ERROR("Failed to open {}", rom_path);
+    return 1;
+  }
+
+  // Block the signals before any worker starts so that only sigwait sees them.
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  auto server = game_server::create(
+      conf, make_shared<const rom_image<cow_statemachine::MEMORY_SIZE>>(
+                *possible_mem));
+  if (!server) {
+    return 1;
+  }
+  LOG_INFO("Serving {} on {} with {} workers", rom_path, conf.socket_path,
+           conf.workers);
+
+  int signal;
+  sigwait(&signals, &signal);
+  LOG_INFO("Shutting down with {} sessions", server->sessions());
+  return 0;
+}
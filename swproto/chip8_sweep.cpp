@@ -0,0 +1,122 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "log.hpp"
+#include "rom.hpp"
+#include "sweep.hpp"
+
+/// Reads one hex keystate per line, each held for `frames` frames. Blank
+/// lines and lines starting with '#' are skipped, so chip8_search output can
+/// be used as is when `frames` matches its --frames-per-action.
+static std::optional<std::vector<uint16_t>>
+read_inputs(const std::string &path, unsigned frames) {
+  std::ifstream in(path);
+  if (!in.is_open()) {
+    return std::nullopt;
+  }
+  std::vector<uint16_t> ret;
+  for (std::string line; std::getline(in, line);) {
+    if (line.empty() || line.starts_with('#')) {
+      continue;
+    }
+    char *end;
+    uint16_t keystate = strtoul(line.c_str(), &end, 16);
+    if (end == line.c_str()) {
+      return std::nullopt;
+    }
+    ret.insert(ret.end(), frames, keystate);
+  }
+  return ret;
+}
+
+/// Runs a ROM under every combination of quirks and prints where they
+/// diverge.
+int main(int argc, char **argv) {
+  using namespace std;
+
+  sweep_config conf{.base = {.pc = statemachine::PROG_BEGIN,
+                             .font_begin = 0x000,
+                             .fuse_instructions = true},
+                    .threads = max(thread::hardware_concurrency(), 1u)};
+  string path;
+  optional<string> input_path;
+  // chip8_search's default, so its solutions replay unchanged.
+  unsigned frames_per_input = 4;
+  for (int i = 1; i < argc; ++i) {
+    string_view arg = argv[i];
+    const char *value = argv[i] + arg.find('=') + 1;
+    if (arg.starts_with("--input=")) {
+      input_path = value;
+    } else if (arg.starts_with("--frames-per-input=")) {
+      frames_per_input = strtoul(value, nullptr, 10);
+    } else if (arg.starts_with("--frames=")) {
+      conf.frames = strtoul(value, nullptr, 10);
+    } else if (arg.starts_with("--threads=")) {
+      conf.threads = strtoul(value, nullptr, 10);
+    } else if (arg == "--no-fusion") {
+      conf.base.fuse_instructions = false;
+    } else if (!arg.starts_with("--") && path.empty()) {
+      path = arg;
+    } else {
+      path.clear();
+      break;
+    }
+  }
+
+  if (path.empty()) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--input=<file>] [--frames-per-input=<count>]"
+                 " [--frames=<count>] [--threads=<count>] [--no-fusion]"
+                 " <ROM.ch8>\n";
+    return 1;
+  }
+
+  if (input_path) {
+    auto inputs = read_inputs(*input_path, frames_per_input);
+    if (!inputs) {
+      LOG_ERROR("Failed to read {}", *input_path);
+      return 1;
+    }
+    conf.inputs = std::move(*inputs);
+  }
+
+  auto possible_mem = try_load(path);
+  if (!possible_mem.has_value()) {
+    LOG_ERROR("Failed to open {}", path);
+    return 1;
+  }
+
+  auto result = sweep_quirks(*possible_mem, conf);
+  unsigned configs = result.stopped.size();
+  LOG_INFO("Ran {} of {} configuration-frames", result.frames_run,
+           uint64_t{configs} * conf.frames);
+
+  if (result.divergences.empty()) {
+    cout << "All " << configs << " configurations agree for " << conf.frames
+         << " frames\n";
+  }
+  for (const divergence &d : result.divergences) {
+    cout << "frame " << d.frame << ": " << quirk_names(d.quirks)
+         << (d.visible ? " (display differs)" : " (state differs)") << '\n';
+    for (const auto &group : d.groups) {
+      cout << " ";
+      for (unsigned config : group) {
+        cout << " [" << quirk_names(config) << ']';
+      }
+      cout << '\n';
+    }
+  }
+  for (unsigned config = 0; config < configs; ++config) {
+    if (result.statuses[config] != statemachine_common::NO_ERROR) {
+      cout << '[' << quirk_names(config) << "] stopped with error "
+           << static_cast<int>(result.statuses[config]) << " in frame "
+           << result.stopped[config] << '\n';
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,125 @@
+#include <atomic>
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <new>
+#include <vector>
+
+#include "chip8.h"
+
+// Counts every allocation in the process, the library's included. The
+// standard operator delete releases memory with free(), so it still pairs.
+static std::atomic<uint64_t> allocations{0};
+
+void *operator new(size_t size) {
+  ++allocations;
+  if (void *ptr = std::malloc(size ? size : 1)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+TEST(Chip8Test, TestBatchStepRewards) {
+  const uint8_t rom[] = {
+      0xA3, 0x00, // LD I, 0x300
+      0x70, 0x01, // ADD V0, 1
+      0xF0, 0x55, // LD [I], V0
+      0x12, 0x02, // JP 0x202
+  };
+  chip8_pool *pool =
+      chip8_pool_create(rom, sizeof(rom), 3, 30, CHIP8_QUIRK_LOAD_STORE);
+  ASSERT_NE(pool, nullptr);
+  ASSERT_EQ(chip8_pool_size(pool), 3);
+  const uint16_t reward_address = 0x300;
+  ASSERT_EQ(chip8_pool_set_reward_addresses(pool, &reward_address, 1), 0);
+
+  std::vector<uint16_t> keys(3, 0);
+  std::vector<uint8_t> displays(3 * chip8_display_size());
+  std::vector<uint8_t> rewards(3), done(3);
+  ASSERT_EQ(chip8_batch_step(pool, keys.data(), 1, displays.data(),
+                             rewards.data(), done.data()),
+            0);
+  // One cycle for LD I, then ten iterations of the loop.
+  ASSERT_EQ(rewards, std::vector<uint8_t>(3, 10));
+  ASSERT_EQ(done, std::vector<uint8_t>(3, 0));
+
+  chip8_pool_reset(pool, 1);
+  ASSERT_EQ(chip8_batch_step(pool, keys.data(), 2, nullptr, rewards.data(),
+                             nullptr),
+            0);
+  ASSERT_EQ(rewards, (std::vector<uint8_t>{30, 20, 30}));
+
+  std::vector<uint64_t> hashes(3);
+  chip8_pool_state_hashes(pool, hashes.data());
+  ASSERT_EQ(hashes[0], hashes[2]);
+  ASSERT_NE(hashes[0], hashes[1]);
+  chip8_pool_destroy(pool);
+}
+
+TEST(Chip8Test, TestDoneFlags) {
+  const uint8_t rom[] = {
+      0xF0, 0x0A, // LD V0, K
+      0x00, 0xEE, // RET (fails)
+  };
+  chip8_pool *pool = chip8_pool_create(rom, sizeof(rom), 2, 11, 0);
+  ASSERT_NE(pool, nullptr);
+
+  std::vector<uint16_t> keys = {0, 0};
+  std::vector<uint8_t> done(2);
+  ASSERT_EQ(chip8_batch_step(pool, keys.data(), 10, nullptr, nullptr,
+                             done.data()),
+            0);
+
+  keys[1] = 1u << 3u;
+  ASSERT_EQ(chip8_batch_step(pool, keys.data(), 1, nullptr, nullptr,
+                             done.data()),
+            1);
+  ASSERT_EQ(done, (std::vector<uint8_t>{0, 1}));
+
+  chip8_pool_reset(pool, 1);
+  ASSERT_EQ(chip8_batch_step(pool, nullptr, 1, nullptr, nullptr, done.data()),
+            0);
+  chip8_pool_destroy(pool);
+
+  const std::vector<uint8_t> too_big(0x1000);
+  ASSERT_EQ(chip8_pool_create(too_big.data(), too_big.size(), 1, 11, 0),
+            nullptr);
+}
+
+TEST(Chip8Test, TestCreateFailures) {
+  const uint8_t rom[] = {0x12, 0x00}; // JP 0x200
+  ASSERT_EQ(chip8_pool_create(rom, sizeof(rom), 0, 30, 0), nullptr);
+  ASSERT_EQ(chip8_pool_create(rom, sizeof(rom), 1, 0, 0), nullptr);
+  std::vector<uint8_t> huge(4096);
+  ASSERT_EQ(chip8_pool_create(huge.data(), huge.size(), 1, 30, 0), nullptr);
+  // Far more machines than fit in memory: NULL rather than an exception.
+  ASSERT_EQ(chip8_pool_create(rom, sizeof(rom), UINT32_MAX, 30, 0), nullptr);
+}
+
+TEST(Chip8Test, TestBatchStepDoesNotAllocate) {
+  // Writes to a page of its own every frame.
+  const uint8_t rom[] = {
+      0xA3, 0x00, // LD I, 0x300
+      0x70, 0x01, // ADD V0, 1
+      0xF0, 0x55, // LD [I], V0
+      0x12, 0x02, // JP 0x202
+  };
+  chip8_pool *pool =
+      chip8_pool_create(rom, sizeof(rom), 8, 30, CHIP8_QUIRK_LOAD_STORE);
+  ASSERT_NE(pool, nullptr);
+  const uint16_t reward_address = 0x300;
+  ASSERT_EQ(chip8_pool_set_reward_addresses(pool, &reward_address, 1), 0);
+  std::vector<uint16_t> keys(8, 0);
+  std::vector<uint8_t> displays(8 * chip8_display_size());
+  std::vector<uint8_t> rewards(8), done(8);
+
+  uint64_t before = allocations;
+  for (int batch = 0; batch < 2; ++batch) {
+    chip8_batch_step(pool, keys.data(), 2, displays.data(), rewards.data(),
+                     done.data());
+    chip8_pool_reset(pool, 3);
+  }
+  uint64_t after = allocations;
+  ASSERT_EQ(after, before);
+  ASSERT_NE(rewards[0], 0) << "the machines did write to memory";
+  chip8_pool_destroy(pool);
+}
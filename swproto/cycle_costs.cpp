@@ -0,0 +1,77 @@
+#include <cctype>
+#include <fstream>
+#include <sstream>
+
+#include "cycle_costs.hpp"
+
+/// Returns the hex digit `c` stands for, or -1 for a placeholder like x or n.
+static int hex_digit(char c) {
+  if (std::isdigit(static_cast<unsigned char>(c))) {
+    return c - '0';
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+/// Returns the entry an instruction name refers to, or nullptr.
+static uint16_t *entry_for(cycle_costs &c, const std::string &name) {
+  if (name.size() != 4 || hex_digit(name[0]) < 0) {
+    return nullptr;
+  }
+  int group = hex_digit(name[0]);
+  if (group == 0x0) {
+    return name == "00E0" ? &c.clear_screen
+           : name == "00EE" ? &c.ret
+                            : &c.by_group[0];
+  }
+  if (group == 0x8) {
+    int op = hex_digit(name[3]);
+    return op < 0 ? nullptr : &c.alu[op];
+  }
+  if (group == 0xF) {
+    int hi = hex_digit(name[2]);
+    int lo = hex_digit(name[3]);
+    return (hi < 0 || lo < 0) ? nullptr : &c.misc[hi * 16 + lo];
+  }
+  return &c.by_group[group];
+}
+
+std::optional<cycle_costs> load_cycle_costs(const std::string &path) {
+  std::ifstream in(path);
+  if (!in.is_open()) {
+    return std::nullopt;
+  }
+
+  cycle_costs costs = cycle_costs::cosmac_vip();
+  for (std::string line; std::getline(in, line);) {
+    std::istringstream fields(line);
+    std::string name;
+    uint32_t cycles;
+    if (!(fields >> name) || name.starts_with('#')) {
+      continue;
+    }
+    if (!(fields >> cycles)) {
+      return std::nullopt;
+    }
+
+    if (name == "frame") {
+      costs.cycles_per_frame = cycles;
+      continue;
+    }
+    uint16_t *entry = name == "fetch"           ? &costs.fetch
+                      : name == "sprite_row"    ? &costs.sprite_row
+                      : name == "unaligned_row" ? &costs.unaligned_row
+                      : name == "per_register"  ? &costs.per_register
+                                                : entry_for(costs, name);
+    if (!entry || cycles > UINT16_MAX) {
+      return std::nullopt;
+    }
+    *entry = cycles;
+  }
+  if (costs.cycles_per_frame == 0) {
+    return std::nullopt;
+  }
+  return costs;
+}
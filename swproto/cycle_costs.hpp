@@ -0,0 +1,105 @@
+#ifndef SWIMP_CYCLE_COSTS_H
+#define SWIMP_CYCLE_COSTS_H
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+/**
+ * How many cycles each instruction adds to a machine's cycles(), for running
+ * at the speed of a particular interpreter rather than a flat number of
+ * instructions per frame.
+ *
+ * Every instruction costs `fetch` plus its own entry. Dxyn additionally costs
+ * `sprite_row` per row, and `unaligned_row` more per row when Vx isn't a
+ * multiple of 8 and every sprite byte straddles two display bytes. Fx55 and
+ * Fx65 cost `per_register` per register copied. Skips cost the same whether
+ * or not they are taken.
+ */
+struct cycle_costs {
+  /// Cycles in one 60Hz frame; the machine's timers tick at this rate.
+  uint32_t cycles_per_frame;
+  uint16_t fetch;
+  /// 00E0 and 00EE; other 0nnn instructions use by_group[0].
+  uint16_t clear_screen;
+  uint16_t ret;
+  /// Indexed by the top nibble of the opcode, for every group but 8 and F.
+  std::array<uint16_t, 16> by_group;
+  /// 8xyN, indexed by N.
+  std::array<uint16_t, 16> alu;
+  /// FxKK, indexed by KK.
+  std::array<uint16_t, 256> misc;
+  uint16_t sprite_row;
+  uint16_t unaligned_row;
+  uint16_t per_register;
+
+  /// Cost of `opcode` when Vx holds `vx`.
+  constexpr uint32_t cost(uint16_t opcode, uint8_t vx) const {
+    uint32_t ret_cost = fetch;
+    switch (opcode >> 12) {
+    case 0x0:
+      return ret_cost + (opcode == 0x00E0   ? clear_screen
+                         : opcode == 0x00EE ? ret
+                                            : by_group[0]);
+    case 0x8:
+      return ret_cost + alu[opcode & 0xF];
+    case 0xD:
+      return ret_cost + by_group[0xD] +
+             (opcode & 0xF) * (sprite_row + ((vx & 7) ? unaligned_row : 0));
+    case 0xF: {
+      uint8_t kk = opcode & 0xFF;
+      ret_cost += misc[kk];
+      if (kk == 0x55 || kk == 0x65) {
+        ret_cost += (((opcode >> 8) & 0xF) + 1) * per_register;
+      }
+      return ret_cost;
+    }
+    default:
+      return ret_cost + by_group[opcode >> 12];
+    }
+  }
+
+  /**
+   * Approximate timings of the original COSMAC VIP interpreter, in 1802
+   * machine cycles (8 clocks at 1.76 MHz). The display DMA that steals part
+   * of every frame on real hardware isn't modelled.
+   */
+  static constexpr cycle_costs cosmac_vip() {
+    cycle_costs c{
+        .cycles_per_frame = 3668,
+        .fetch = 40,
+        .clear_screen = 3078,
+        .ret = 10,
+        .by_group = {12, 12, 26, 10, 10, 14, 6, 10, 0, 14, 12, 22, 36, 26, 14,
+                     0},
+        .alu = {12, 44, 44, 44, 44, 44, 44, 44, 0, 0, 0, 0, 0, 0, 44, 0},
+        .misc = {},
+        .sprite_row = 46,
+        .unaligned_row = 20,
+        .per_register = 14,
+    };
+    c.misc[0x07] = 10;
+    c.misc[0x0A] = 18;
+    c.misc[0x15] = 10;
+    c.misc[0x18] = 10;
+    c.misc[0x1E] = 16;
+    c.misc[0x29] = 16;
+    c.misc[0x33] = 84;
+    c.misc[0x55] = 14;
+    c.misc[0x65] = 14;
+    return c;
+  }
+};
+
+/**
+ * Reads a cost table starting from COSMAC VIP timings. Each non-empty line
+ * that doesn't start with '#' is `<name> <cycles>`, where the name is an
+ * instruction as written in the usual references ("00E0", "7xkk", "8xy4",
+ * "Fx33", ...) or one of frame, fetch, sprite_row, unaligned_row and
+ * per_register. Returns nullopt if the file can't be read or a line doesn't
+ * parse.
+ */
+std::optional<cycle_costs> load_cycle_costs(const std::string &path);
+
+#endif // SWIMP_CYCLE_COSTS_H
@@ -1,61 +1,108 @@
+#include <SFML/Audio.hpp>
 #include <SFML/Graphics.hpp>
 #include <SFML/System/Vector2.hpp>
 #include <SFML/Window/Event.hpp>
 #include <SFML/Window/Keyboard.hpp>
 #include <algorithm>
 #include <bitset>
+#include <cstdlib>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <optional>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <vector>
 
+#include "audio.hpp"
+#include "cycle_costs.hpp"
 #include "font.hpp"
+#include "frame_export.hpp"
+#include "hud.hpp"
+#include "latency.hpp"
+#include "log.hpp"
+#include "rom.hpp"
+#include "rom_library.hpp"
 #include "statemachine.hpp"
+#include "video.hpp"
 
 const size_t SCALING_FACTOR = 1700 / statemachine::DISPLAY_WIDTH;
-
-std::string mem_of(const statemachine &mach) {
-  using namespace std;
-  stringstream mem_str;
-  mem_str << "mem:";
-  unsigned i = 0;
-  for (uint8_t val : mach.memory()) {
-    if ((i++ % 32) == 0) {
-      mem_str << "\n  ";
-    }
-    mem_str << hex << setw(2) << setfill('0') << (int)val << " ";
+const unsigned FRAMES_PER_SECOND = 60;
+const unsigned CYCLES_PER_FRAME = 700 / FRAMES_PER_SECOND;
+const unsigned SAMPLE_RATE = 44100;
+
+/// Plays samples from the audio ring, padding underruns with silence.
+class ring_sound_stream : public sf::SoundStream {
+public:
+  ring_sound_stream(spsc_ring<int16_t> &ring, size_t chunk_size)
+      : m_ring(ring), m_chunk(chunk_size) {
+    initialize(1, SAMPLE_RATE);
   }
-  return mem_str.str();
-}
 
-/// Reads file contents into CHIP8 memory and places fonts starting at 0x000.
-std::optional<std::array<uint8_t, statemachine::MEMORY_SIZE>>
-try_load(std::string path) {
-  using namespace std;
-  array<uint8_t, statemachine::MEMORY_SIZE> ret;
-  copy(font.begin(), font.end(), ret.begin());
-  ifstream fs(path, std::fstream::in);
-  if (!fs.is_open()) {
-    return nullopt;
+  /// SFML's streaming thread must be stopped before onGetData() goes away.
+  ~ring_sound_stream() override { stop(); }
+
+private:
+  bool onGetData(Chunk &data) override {
+    size_t count = m_ring.pop(m_chunk);
+    std::fill(m_chunk.begin() + count, m_chunk.end(), 0);
+    data.samples = m_chunk.data();
+    data.sampleCount = m_chunk.size();
+    return true;
   }
 
-  fs.read(reinterpret_cast<char *>(ret.data() + statemachine::PROG_BEGIN),
-          statemachine::MEMORY_SIZE - statemachine::PROG_BEGIN);
+  void onSeek(sf::Time) override {}
+
+  spsc_ring<int16_t> &m_ring;
+  std::vector<int16_t> m_chunk;
+};
 
-  // If the file doesn't fill up memory,
-  // fill the remainder with 0's.
-  if (fs.eof()) {
-    auto mem_prog_begin = ret.begin() + statemachine::PROG_BEGIN + fs.gcount();
-    std::fill(mem_prog_begin, ret.end(), 0);
+/// Logs the machine's memory at debug level, 32 bytes per line.
+void log_memory(const statemachine &mach) {
+  using namespace std;
+  if (!SWIMP_LOG_ENABLED(log_level::debug)) {
+    return;
+  }
+  auto mem = mach.memory();
+  for (size_t row = 0; row < mem.size(); row += 32) {
+    stringstream row_str;
+    for (size_t i = row; i < row + 32; ++i) {
+      row_str << hex << setw(2) << setfill('0') << (int)mem[i] << " ";
+    }
+    LOG_DEBUG("mem {:03x}: {}", row, row_str.str());
   }
+}
 
-  // Make sure that the file is no larger than the available space.
-  if (fs.peek() != ifstream::traits_type::eof()) {
-    return nullopt;
+/// Logs a multi-line report at info level, one record per line.
+void log_report(const latency_tracker &latency) {
+  std::stringstream report;
+  latency.report(report);
+  for (std::string line; std::getline(report, line);) {
+    LOG_INFO("{}", line);
   }
+}
 
-  return ret;
+/**
+ * Runs a copy of the machine `frames` frames past frame_end with the keys held
+ * as they are now, for run-ahead. Reuses `ahead` so that no frame allocates.
+ * The real machine is left untouched, so there is nothing to roll back.
+ */
+void run_ahead(const statemachine &machine, statemachine &ahead,
+               uint16_t keystate, uint64_t frame_end, unsigned frames,
+               uint32_t cycles_per_frame) {
+  ahead = machine;
+  uint64_t end = frame_end + uint64_t{frames} * cycles_per_frame;
+  while (ahead.cycles() < end) {
+    auto status = ahead.step(keystate);
+    if (status == statemachine_common::WAITING_FOR_KEYPRESS) {
+      ahead.idle_until(end);
+    } else if (status < 0) {
+      // The real machine reports the error once it gets there.
+      break;
+    }
+  }
 }
 
 /// Returns true if it handled a KeyPressed or KeyReleased event.
@@ -134,31 +181,133 @@ bool update_keys(uint16_t &keystate, sf::Event &event) {
 int main(int argc, char **argv) {
   using namespace std;
 
-  if (argc != 2) {
-    std::cerr << "Usage: " << argv[0] << " <ROM.ch8>\n";
+  string path;
+  optional<string> export_name;
+  optional<string> record_path;
+  unsigned long audio_latency_ms = 50;
+  unsigned long run_ahead_frames = 0;
+  bool fuse = true;
+  optional<cycle_costs> costs;
+  bool bad_costs = false;
+  optional<string> library_path;
+  for (int i = 1; i < argc; ++i) {
+    string_view arg = argv[i];
+    if (arg.starts_with("--export-frames=")) {
+      export_name = arg.substr(arg.find('=') + 1);
+    } else if (arg.starts_with("--record=")) {
+      record_path = arg.substr(arg.find('=') + 1);
+    } else if (arg.starts_with("--audio-latency=")) {
+      audio_latency_ms = strtoul(argv[i] + arg.find('=') + 1, nullptr, 10);
+    } else if (arg.starts_with("--run-ahead=")) {
+      run_ahead_frames = strtoul(argv[i] + arg.find('=') + 1, nullptr, 10);
+    } else if (arg == "--no-fusion") {
+      fuse = false;
+    } else if (arg == "--cost-model=vip") {
+      costs = cycle_costs::cosmac_vip();
+    } else if (arg.starts_with("--cost-model=")) {
+      costs = load_cycle_costs(string(arg.substr(arg.find('=') + 1)));
+      bad_costs = !costs;
+    } else if (arg.starts_with("--library=")) {
+      library_path = arg.substr(arg.find('=') + 1);
+    } else if (!arg.starts_with("--") && path.empty()) {
+      path = arg;
+    } else {
+      path.clear();
+      break;
+    }
+  }
+
+  if (path.empty()) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--export-frames=<shm name>] [--record=<file>]"
+                 " [--audio-latency=<ms>] [--run-ahead=<frames>]"
+                 " [--no-fusion] [--cost-model=vip|<file>]"
+                 " [--library=<index>] <ROM.ch8 | name in library>\n"
+                 "With --run-ahead, exported and recorded frames are the ones"
+                 " shown, but the\nlatency report follows the real machine.\n";
     return 1;
   }
 
-  string path = argv[1];
+  if (const char *level_name = getenv("CHIP8_LOG_LEVEL")) {
+    log_level level;
+    if (!parse_log_level(level_name, level)) {
+      cerr << "CHIP8_LOG_LEVEL must be one of error, warn, info, debug or "
+              "trace\n";
+      return 1;
+    }
+    logger::instance().set_level(level);
+  }
 
-  if (!path.ends_with(".ch8")) {
-    cerr << "path has invalid extension (expected .ch8)\n";
+  if (bad_costs) {
+    LOG_ERROR("Failed to read the cost model");
     return 1;
   }
 
-  auto possible_mem = try_load(path);
-  if (!possible_mem.has_value()) {
-    cerr << "Failed to open " << path << endl;
-    return 1;
+  // A library ROM is already laid out in memory and comes with a profile.
+  rom_profile profile = rom_profile::defaults();
+  shared_ptr<const rom_image<statemachine::MEMORY_SIZE>> image;
+  if (library_path) {
+    auto rom = load_from_library(*library_path, path);
+    if (!rom) {
+      return 1;
+    }
+    image = std::move(rom->image);
+    profile = rom->profile;
+  } else {
+    if (!path.ends_with(".ch8")) {
+      LOG_ERROR("path has invalid extension (expected .ch8)");
+      return 1;
+    }
+    auto possible_mem = try_load(path);
+    if (!possible_mem.has_value()) {
+      LOG_ERROR("Failed to open {}", path);
+      return 1;
+    }
+    image = make_shared<const rom_image<statemachine::MEMORY_SIZE>>(
+        *possible_mem);
+  }
+
+  // With a cost model a frame is that interpreter's cycles per frame rather
+  // than a fixed number of instructions; otherwise the profile may set it.
+  uint32_t cycles_per_frame = CYCLES_PER_FRAME;
+  if (costs) {
+    cycles_per_frame = costs->cycles_per_frame;
+  } else if (profile.cycles_per_frame) {
+    cycles_per_frame = profile.cycles_per_frame;
   }
 
-  statemachine machine(*possible_mem, {
-                                          .pc = 0x200,
-                                          .font_begin = 0x000,
-                                      });
-  cout << mem_of(machine) << endl;
+  statemachine::init_conf conf{
+      .pc = 0x200,
+      .font_begin = 0x000,
+      .fuse_instructions = fuse,
+      .costs = costs ? &*costs : nullptr,
+  };
+  profile.apply(conf);
+  conf.cycles_per_tick = cycles_per_frame;
+  statemachine machine(*image, conf);
+  log_memory(machine);
+
+  LOG_INFO("Successfully loaded {}", path);
+
+  auto exporter = export_name ? frame_exporter::create(
+                                   *export_name, statemachine::DISPLAY_WIDTH,
+                                   statemachine::DISPLAY_HEIGHT)
+                             : nullopt;
+  if (export_name) {
+    if (!exporter) {
+      return 1;
+    }
+    LOG_INFO("Exporting frames to shared memory {}", *export_name);
+  }
 
-  cout << "Successfully loaded " << argv[1] << '\n';
+  auto recorder = record_path ? video_writer::create(
+                                    *record_path, statemachine::DISPLAY_WIDTH,
+                                    statemachine::DISPLAY_HEIGHT)
+                              : nullopt;
+  if (record_path && !recorder) {
+    LOG_ERROR("Failed to create {}", *record_path);
+    return 1;
+  }
 
   sf::RectangleShape pixel(sf::Vector2f(SCALING_FACTOR, SCALING_FACTOR));
 
@@ -167,34 +316,84 @@ int main(int argc, char **argv) {
                     SCALING_FACTOR * statemachine::DISPLAY_HEIGHT),
       "CHIP8 Emulator");
 
-  window.setFramerateLimit(60);
-
+  window.setFramerateLimit(FRAMES_PER_SECOND);
+
+  // The ring holds at most the requested latency worth of samples; the sound
+  // card pulls it in quarters.
+  size_t audio_buffer = max<size_t>(SAMPLE_RATE * audio_latency_ms / 1000, 64);
+  spsc_ring<int16_t> audio_ring(audio_buffer);
+  audio_generator audio(audio_ring, SAMPLE_RATE,
+                        cycles_per_frame * FRAMES_PER_SECOND);
+  ring_sound_stream sound(audio_ring, audio_buffer / 4);
+  sound.play();
+
+  // Games typically react to a key a frame or more after polling it. With
+  // run-ahead the window shows what the machine will display that many frames
+  // from now if the keys stay as they are, which hides that lag.
+  statemachine ahead = machine;
+
+  // Give transitions about a second to show up, in the machine's own cycles.
+  latency_tracker latency(uint64_t{cycles_per_frame} * FRAMES_PER_SECOND);
+  perf_hud hud(SCALING_FACTOR / 4.0f, costs.has_value());
+  // Keys by keypad position, and as the machine sees them after the
+  // profile's key map.
+  uint16_t keypad = 0;
   uint16_t keystate = 0;
+  uint64_t frame_end = 0;
   int ret = 0;
   while (window.isOpen()) {
+    hud.frame_begin();
     window.clear();
 
-    for (int i = 0; (ret == 0) && (i < (700 / 60)); ++i) {
+    // Fused instructions retire several cycles per step, so budget the frame
+    // in cycles rather than steps. Overruns are paid back next frame.
+    frame_end += cycles_per_frame;
+    while ((ret == 0) && (machine.cycles() < frame_end)) {
       // Process events before every machine step.
       for (sf::Event event; window.pollEvent(event);) {
         // Close window: exit
         if (event.type == sf::Event::Closed) {
           window.close();
+        } else if (event.type == sf::Event::KeyPressed &&
+                   event.key.code == sf::Keyboard::F1) {
+          log_report(latency);
+        } else if (event.type == sf::Event::KeyPressed &&
+                   event.key.code == sf::Keyboard::F2) {
+          hud.toggle();
         } else {
-          update_keys(keystate, event);
+          uint16_t old_keystate = keystate;
+          update_keys(keypad, event);
+          keystate = profile.map_keys(keypad);
+          if (keystate != old_keystate) {
+            latency.key_event(old_keystate, keystate, machine);
+          }
         }
       }
 
-      auto status = machine.step(keystate, i == 0 /* Only tick once. */);
+      latency.before_step(machine);
+      auto status = machine.step(keystate);
+      latency.after_step(machine);
+      audio.observe(machine);
+      hud.observe(status);
       if (status < 0) {
-        cerr << "machine reported error " << status << endl;
+        LOG_ERROR("machine reported error {}", static_cast<int>(status));
         window.close();
         ret = 1;
         break;
       }
     }
 
-    auto display = machine.display();
+    audio.render_until(machine.cycles());
+    hud.emulated(machine.cycles());
+
+    // Exported and recorded frames are the ones the player saw.
+    const statemachine *shown = &machine;
+    if (run_ahead_frames && ret == 0) {
+      run_ahead(machine, ahead, keystate, frame_end, run_ahead_frames,
+                cycles_per_frame);
+      shown = &ahead;
+    }
+    auto display = shown->display();
 
     for (size_t y = 0; y < statemachine::DISPLAY_HEIGHT; ++y) {
       auto row_begin = y * statemachine::ROW_SIZE;
@@ -219,8 +418,21 @@ int main(int argc, char **argv) {
     }
     */
 
+    // Drawn over the guest's pixels; the machine's display is untouched.
+    hud.draw(window);
     window.display();
+    // The latency report follows the real machine, so it doesn't include
+    // the lag that run-ahead hides.
+    latency.frame_presented(machine);
+    if (exporter) {
+      exporter->publish(*shown);
+    }
+    if (recorder) {
+      recorder->write_frame(display);
+    }
   }
+
+  log_report(latency);
   return ret;
 }
 
@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "frame_export.hpp"
+#include "log.hpp"
+
+static size_t slot_size_for(uint32_t display_size) {
+  // Keep slots cache-line aligned so that writers and readers of neighbouring
+  // slots don't share lines.
+  size_t size = sizeof(frame_ring_slot) + display_size;
+  return (size + 63) & ~size_t{63};
+}
+
+static size_t ring_size(uint32_t slots, size_t slot_size) {
+  return ((sizeof(frame_ring_header) + 63) & ~size_t{63}) + slots * slot_size;
+}
+
+static frame_ring_slot *slot_at(void *base, uint64_t frame) {
+  auto *header = static_cast<frame_ring_header *>(base);
+  auto *first = static_cast<uint8_t *>(base) +
+                ((sizeof(frame_ring_header) + 63) & ~size_t{63});
+  return reinterpret_cast<frame_ring_slot *>(
+      first + (frame % header->slots) * header->slot_size);
+}
+
+static uint8_t *slot_display(frame_ring_slot *slot) {
+  return reinterpret_cast<uint8_t *>(slot) + sizeof(frame_ring_slot);
+}
+
+std::optional<frame_exporter> frame_exporter::create(const std::string &name,
+                                                     uint16_t width,
+                                                     uint16_t height,
+                                                     uint32_t slots) {
+  uint32_t display_size = (width / 8) * height;
+  size_t slot_size = slot_size_for(display_size);
+  size_t size = ring_size(slots, slot_size);
+
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    LOG_ERROR("shm_open({}) failed: {}", name, std::strerror(errno));
+    return std::nullopt;
+  }
+  if (ftruncate(fd, size) != 0) {
+    LOG_ERROR("ftruncate({}) failed: {}", name, std::strerror(errno));
+    close(fd);
+    shm_unlink(name.c_str());
+    return std::nullopt;
+  }
+  void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    LOG_ERROR("mmap({}) failed: {}", name, std::strerror(errno));
+    shm_unlink(name.c_str());
+    return std::nullopt;
+  }
+
+  // The mapping starts zeroed, so the atomics only need to be constructed.
+  auto *header = new (base) frame_ring_header{
+      .magic = FRAME_RING_MAGIC,
+      .version = FRAME_RING_VERSION,
+      .slots = slots,
+      .slot_size = static_cast<uint32_t>(slot_size),
+      .width = width,
+      .height = height,
+      .display_size = display_size,
+  };
+  header->published.store(0, std::memory_order_relaxed);
+  for (uint32_t i = 0; i < slots; ++i) {
+    new (slot_at(base, i)) frame_ring_slot{};
+  }
+
+  return frame_exporter(name, base, size);
+}
+
+frame_exporter::frame_exporter(std::string name, void *base, size_t size)
+    : m_name(std::move(name)), m_base(base), m_size(size) {}
+
+frame_exporter::frame_exporter(frame_exporter &&other)
+    : m_name(std::move(other.m_name)), m_base(other.m_base),
+      m_size(other.m_size) {
+  other.m_base = nullptr;
+}
+
+frame_exporter::~frame_exporter() {
+  if (m_base) {
+    munmap(m_base, m_size);
+    shm_unlink(m_name.c_str());
+  }
+}
+
+void frame_exporter::publish(uint64_t cycle, bool sound,
+                             std::span<const uint8_t> display) {
+  auto *header = static_cast<frame_ring_header *>(m_base);
+  uint64_t frame = header->published.load(std::memory_order_relaxed);
+  frame_ring_slot *slot = slot_at(m_base, frame);
+
+  uint32_t seq = slot->sequence.load(std::memory_order_relaxed);
+  slot->sequence.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot->frame = frame;
+  slot->cycle = cycle;
+  slot->sound = sound;
+  std::memcpy(slot_display(slot), display.data(),
+              std::min<size_t>(display.size(), header->display_size));
+
+  slot->sequence.store(seq + 2, std::memory_order_release);
+  header->published.store(frame + 1, std::memory_order_release);
+}
+
+std::optional<frame_reader> frame_reader::open(const std::string &name) {
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    return std::nullopt;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      static_cast<size_t>(st.st_size) < sizeof(frame_ring_header)) {
+    close(fd);
+    return std::nullopt;
+  }
+  void *base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    return std::nullopt;
+  }
+
+  // The segment comes from another process, so check everything read()
+  // relies on: at least one slot, slots that hold a whole frame and keep
+  // their atomics aligned, and all of them inside the mapping.
+  auto *header = static_cast<const frame_ring_header *>(base);
+  if (header->magic != FRAME_RING_MAGIC ||
+      header->version != FRAME_RING_VERSION || header->slots == 0 ||
+      header->slot_size < slot_size_for(header->display_size) ||
+      header->slot_size % alignof(frame_ring_slot) != 0 ||
+      ring_size(header->slots, header->slot_size) >
+          static_cast<size_t>(st.st_size)) {
+    munmap(base, st.st_size);
+    return std::nullopt;
+  }
+  return frame_reader(base, st.st_size);
+}
+
+frame_reader::frame_reader(void *base, size_t size)
+    : m_base(base), m_size(size) {}
+
+frame_reader::frame_reader(frame_reader &&other)
+    : m_base(other.m_base), m_size(other.m_size) {
+  other.m_base = nullptr;
+}
+
+frame_reader::~frame_reader() {
+  if (m_base) {
+    munmap(m_base, m_size);
+  }
+}
+
+uint64_t frame_reader::published() const {
+  return header().published.load(std::memory_order_acquire);
+}
+
+std::optional<exported_frame>
+frame_reader::read(uint64_t frame, std::span<uint8_t> buffer) const {
+  if (frame >= published()) {
+    return std::nullopt;
+  }
+  frame_ring_slot *slot = slot_at(m_base, frame);
+  size_t size = std::min<size_t>(buffer.size(), header().display_size);
+
+  uint32_t before = slot->sequence.load(std::memory_order_acquire);
+  if (before & 1) {
+    return std::nullopt; // Being written right now.
+  }
+  exported_frame ret{.frame = slot->frame,
+                     .cycle = slot->cycle,
+                     .sound = !!slot->sound,
+                     .display = buffer.first(size)};
+  std::memcpy(buffer.data(), slot_display(slot), size);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  uint32_t after = slot->sequence.load(std::memory_order_relaxed);
+
+  if (before != after || ret.frame != frame) {
+    return std::nullopt;
+  }
+  return ret;
+}
@@ -0,0 +1,120 @@
+#ifndef SWIMP_FRAME_EXPORT_H
+#define SWIMP_FRAME_EXPORT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+
+/*
+ * Layout of the POSIX shared-memory frame ring.
+ *
+ * The object starts with a frame_ring_header followed by `slots` slots of
+ * `slot_size` bytes. Each slot is a frame_ring_slot followed by the packed
+ * 1bpp framebuffer (`display_size` bytes, rows top to bottom, leftmost pixel
+ * in the most significant bit).
+ *
+ * Frame n lives in slot n % slots. A slot is protected by a seqlock: the writer
+ * makes `sequence` odd, writes the slot, then makes it even again. Readers copy
+ * the slot and retry if `sequence` was odd or changed while they copied.
+ * Consumers only need this header; they never need to link the emulator.
+ */
+const static uint32_t FRAME_RING_MAGIC = 0x38504843; // "CHP8"
+const static uint32_t FRAME_RING_VERSION = 1;
+
+struct frame_ring_header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slots;
+  uint32_t slot_size;
+  uint16_t width;
+  uint16_t height;
+  uint32_t display_size;
+  /// Number of frames published so far; the newest is published - 1.
+  std::atomic<uint64_t> published;
+};
+
+struct frame_ring_slot {
+  std::atomic<uint32_t> sequence;
+  uint8_t sound;
+  uint64_t frame;
+  uint64_t cycle;
+  // Followed by display_size bytes of framebuffer.
+};
+
+/// A frame read back out of the ring.
+struct exported_frame {
+  uint64_t frame;
+  uint64_t cycle;
+  bool sound;
+  std::span<const uint8_t> display;
+};
+
+/// Publishes frames into a newly created shared-memory ring.
+class frame_exporter {
+public:
+  /**
+   * Creates (or replaces) the shared-memory object `name`, e.g. "/chip8".
+   * Returns nullopt if it cannot be created or mapped.
+   */
+  static std::optional<frame_exporter> create(const std::string &name,
+                                              uint16_t width, uint16_t height,
+                                              uint32_t slots = 64);
+
+  frame_exporter(frame_exporter &&other);
+  frame_exporter(const frame_exporter &) = delete;
+  frame_exporter &operator=(const frame_exporter &) = delete;
+  ~frame_exporter();
+
+  /// Publishes one frame. Never blocks; slow readers just miss frames.
+  void publish(uint64_t cycle, bool sound, std::span<const uint8_t> display);
+
+  /// Convenience overload for any basic_statemachine.
+  template <class Machine> inline void publish(const Machine &mach) {
+    auto display = mach.display();
+    publish(mach.cycles(), mach.reg_ST() > 0, display);
+  }
+
+private:
+  frame_exporter(std::string name, void *base, size_t size);
+
+  std::string m_name;
+  void *m_base;
+  size_t m_size;
+};
+
+/// Reads frames from a ring created by another process.
+class frame_reader {
+public:
+  static std::optional<frame_reader> open(const std::string &name);
+
+  frame_reader(frame_reader &&other);
+  frame_reader(const frame_reader &) = delete;
+  frame_reader &operator=(const frame_reader &) = delete;
+  ~frame_reader();
+
+  inline const frame_ring_header &header() const {
+    return *static_cast<const frame_ring_header *>(m_base);
+  }
+
+  /// Number of frames published so far.
+  uint64_t published() const;
+
+  /**
+   * Copies frame `frame` into `buffer` (which must hold display_size bytes).
+   * Returns nullopt if the frame has not been published yet or has already
+   * been overwritten.
+   */
+  std::optional<exported_frame> read(uint64_t frame,
+                                     std::span<uint8_t> buffer) const;
+
+private:
+  frame_reader(void *base, size_t size);
+
+  void *m_base;
+  size_t m_size;
+};
+
+#endif // SWIMP_FRAME_EXPORT_H
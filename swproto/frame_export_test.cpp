@@ -0,0 +1,101 @@
+#include <array>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <new>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "frame_export.hpp"
+
+static std::string shm_name(const char *suffix) {
+  return "/chip8_test_" + std::to_string(getpid()) + suffix;
+}
+
+/// Maps `name` writable, as a misbehaving process could.
+static void *map_writable(const std::string &name, size_t size) {
+  int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+  if (fd < 0 || ftruncate(fd, size) != 0) {
+    return nullptr;
+  }
+  void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  return base == MAP_FAILED ? nullptr : base;
+}
+
+TEST(FrameExportTest, TestRoundTrip) {
+  const uint32_t slots = 4;
+  std::string name = shm_name("_ring");
+  auto exporter = frame_exporter::create(name, 64, 32, slots);
+  ASSERT_TRUE(exporter.has_value());
+  auto reader = frame_reader::open(name);
+  ASSERT_TRUE(reader.has_value());
+  ASSERT_EQ(reader->header().display_size, 256);
+
+  std::array<uint8_t, 256> display{}, buffer{};
+  ASSERT_FALSE(reader->read(0, buffer).has_value()) << "not published yet";
+
+  display[0] = 0x80;
+  display[255] = 0x01;
+  exporter->publish(100, true, display);
+  ASSERT_EQ(reader->published(), 1);
+  auto frame = reader->read(0, buffer);
+  ASSERT_TRUE(frame.has_value());
+  ASSERT_EQ(frame->frame, 0);
+  ASSERT_EQ(frame->cycle, 100);
+  ASSERT_TRUE(frame->sound);
+  ASSERT_EQ(frame->display.size(), display.size());
+  ASSERT_TRUE(std::equal(display.begin(), display.end(), buffer.begin()));
+
+  // A full lap later, frame 0's slot holds frame `slots`.
+  for (uint32_t i = 1; i <= slots; ++i) {
+    exporter->publish(100 + i, false, display);
+  }
+  ASSERT_FALSE(reader->read(0, buffer).has_value());
+  frame = reader->read(slots, buffer);
+  ASSERT_TRUE(frame.has_value());
+  ASSERT_EQ(frame->cycle, 100 + slots);
+  ASSERT_FALSE(frame->sound);
+
+  // A slot caught mid-write (odd sequence) is not returned.
+  auto *base = static_cast<uint8_t *>(
+      map_writable(name, sizeof(frame_ring_header) + 64));
+  ASSERT_NE(base, nullptr);
+  auto *slot = reinterpret_cast<frame_ring_slot *>(
+      base + ((sizeof(frame_ring_header) + 63) & ~size_t{63}));
+  slot->sequence.fetch_add(1);
+  ASSERT_FALSE(reader->read(slots, buffer).has_value());
+  slot->sequence.fetch_add(1);
+  ASSERT_TRUE(reader->read(slots, buffer).has_value());
+  munmap(base, sizeof(frame_ring_header) + 64);
+}
+
+TEST(FrameExportTest, TestRejectsBadHeaders) {
+  std::string name = shm_name("_bad");
+  const size_t size = 4096;
+  void *base = map_writable(name, size);
+  ASSERT_NE(base, nullptr);
+  auto write_header = [base](uint32_t slots, uint32_t slot_size) {
+    new (base) frame_ring_header{.magic = FRAME_RING_MAGIC,
+                                 .version = FRAME_RING_VERSION,
+                                 .slots = slots,
+                                 .slot_size = slot_size,
+                                 .width = 64,
+                                 .height = 32,
+                                 .display_size = 256};
+  };
+
+  write_header(4, 320);
+  ASSERT_TRUE(frame_reader::open(name).has_value());
+  write_header(0, 320);
+  ASSERT_FALSE(frame_reader::open(name).has_value()) << "no slots";
+  write_header(4, 256);
+  ASSERT_FALSE(frame_reader::open(name).has_value()) << "slots too small";
+  write_header(4, 330);
+  ASSERT_FALSE(frame_reader::open(name).has_value()) << "misaligned slots";
+  write_header(64, 320);
+  ASSERT_FALSE(frame_reader::open(name).has_value()) << "past the mapping";
+
+  munmap(base, size);
+  shm_unlink(name.c_str());
+}
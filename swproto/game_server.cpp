@@ -0,0 +1,319 @@
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <unordered_map>
+
+#include "game_server.hpp"
+#include "log.hpp"
+#include "video.hpp"
+
+/// Frames a worker catches up on after a stall before it gives up on them.
+static const uint64_t MAX_CATCHUP_FRAMES = 4;
+
+class game_server::worker {
+public:
+  explicit worker(game_server &server);
+  ~worker();
+
+  /// False if the worker's descriptors couldn't be created.
+  inline bool ok() const { return m_thread.joinable(); };
+
+private:
+  struct session {
+    session(int fd, const game_server &server)
+        : fd(fd), machine(server.m_rom,
+                          {
+                              .pc = cow_statemachine::PROG_BEGIN,
+                              .font_begin = 0x000,
+                              .cycles_per_tick = server.m_conf.cycles_per_frame,
+                              .fuse_instructions =
+                                  server.m_conf.fuse_instructions,
+                          }) {}
+
+    int fd;
+    cow_statemachine machine;
+    uint16_t keystate = 0;
+    std::array<uint8_t, 2> key_bytes;
+    unsigned key_fill = 0;
+    uint64_t frame_end = 0;
+    uint64_t sent_generation = 0;
+    bool sent_any = false;
+    std::array<uint8_t, cow_statemachine::DISPLAY_SIZE> sent{};
+    std::vector<uint8_t> out;
+    size_t out_pos = 0;
+    bool want_write = false;
+  };
+
+  void run();
+  void accept_all();
+  /// These return false if the session should be closed.
+  bool read_keys(session &s);
+  bool flush(session &s);
+  bool run_frames(session &s, uint64_t frames);
+  void close_session(int fd);
+
+  game_server &m_server;
+  int m_epoll;
+  int m_timer;
+  int m_stop;
+  std::unordered_map<int, std::unique_ptr<session>> m_sessions;
+  std::thread m_thread;
+};
+
+game_server::worker::worker(game_server &server)
+    : m_server(server), m_epoll(epoll_create1(EPOLL_CLOEXEC)),
+      m_timer(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)),
+      m_stop(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+  if (m_epoll < 0 || m_timer < 0 || m_stop < 0) {
+    LOG_ERROR("failed to create worker: {}", std::strerror(errno));
+    return;
+  }
+  itimerspec period{.it_interval = {.tv_sec = 0, .tv_nsec = 1000000000 / 60},
+                    .it_value = {.tv_sec = 0, .tv_nsec = 1000000000 / 60}};
+  timerfd_settime(m_timer, 0, &period, nullptr);
+
+  // Every worker waits on the listening socket; EPOLLEXCLUSIVE wakes only
+  // one of them per connection, which spreads sessions across the shards.
+  epoll_event ev{.events = EPOLLIN | EPOLLEXCLUSIVE,
+                 .data = {.fd = m_server.m_listen_fd}};
+  epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_server.m_listen_fd, &ev);
+  ev = {.events = EPOLLIN, .data = {.fd = m_timer}};
+  epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_timer, &ev);
+  ev = {.events = EPOLLIN, .data = {.fd = m_stop}};
+  epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_stop, &ev);
+
+  m_thread = std::thread(&worker::run, this);
+}
+
+game_server::worker::~worker() {
+  if (m_thread.joinable()) {
+    uint64_t one = 1;
+    [[maybe_unused]] auto ret = write(m_stop, &one, sizeof(one));
+    m_thread.join();
+  }
+  while (!m_sessions.empty()) {
+    close_session(m_sessions.begin()->first);
+  }
+  for (int fd : {m_epoll, m_timer, m_stop}) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+void game_server::worker::run() {
+  std::array<epoll_event, 64> events;
+  for (;;) {
+    int count = epoll_wait(m_epoll, events.data(), events.size(), -1);
+    if (count < 0 && errno != EINTR) {
+      LOG_ERROR("epoll_wait failed: {}", std::strerror(errno));
+      return;
+    }
+    for (int i = 0; i < count; ++i) {
+      int fd = events[i].data.fd;
+      if (fd == m_stop) {
+        return;
+      } else if (fd == m_server.m_listen_fd) {
+        accept_all();
+      } else if (fd == m_timer) {
+        uint64_t expirations = 0;
+        if (read(m_timer, &expirations, sizeof(expirations)) <= 0) {
+          continue;
+        }
+        expirations = std::min(expirations, MAX_CATCHUP_FRAMES);
+        for (auto it = m_sessions.begin(); it != m_sessions.end();) {
+          session &s = *(it++)->second;
+          if (!run_frames(s, expirations)) {
+            close_session(s.fd);
+          }
+        }
+      } else if (auto it = m_sessions.find(fd); it != m_sessions.end()) {
+        session &s = *it->second;
+        bool ok = !(events[i].events & (EPOLLERR | EPOLLHUP));
+        if (ok && (events[i].events & EPOLLIN)) {
+          ok = read_keys(s);
+        }
+        if (ok && (events[i].events & EPOLLOUT)) {
+          ok = flush(s);
+        }
+        if (!ok) {
+          close_session(fd);
+        }
+      }
+    }
+  }
+}
+
+void game_server::worker::accept_all() {
+  for (;;) {
+    int fd = accept4(m_server.m_listen_fd, nullptr, nullptr,
+                     SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        LOG_WARN("accept failed: {}", std::strerror(errno));
+      }
+      return;
+    }
+    if (m_server.m_sessions.fetch_add(1) >= m_server.m_conf.max_sessions) {
+      --m_server.m_sessions;
+      LOG_WARN("session limit reached, refusing connection");
+      close(fd);
+      continue;
+    }
+    if (m_server.m_conf.send_buffer > 0) {
+      setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &m_server.m_conf.send_buffer,
+                 sizeof(m_server.m_conf.send_buffer));
+    }
+
+    auto s = std::make_unique<session>(fd, m_server);
+    epoll_event ev{.events = EPOLLIN, .data = {.fd = fd}};
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &ev);
+    for (uint16_t v : {cow_statemachine::DISPLAY_WIDTH,
+                       cow_statemachine::DISPLAY_HEIGHT}) {
+      s->out.push_back(v & 0xFF);
+      s->out.push_back(v >> 8);
+    }
+    bool ok = flush(*s);
+    m_sessions.emplace(fd, std::move(s));
+    if (!ok) {
+      close_session(fd);
+    }
+  }
+}
+
+bool game_server::worker::read_keys(session &s) {
+  std::array<uint8_t, 64> buffer;
+  for (;;) {
+    ssize_t count = recv(s.fd, buffer.data(), buffer.size(), 0);
+    if (count == 0) {
+      return false;
+    } else if (count < 0) {
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    for (ssize_t i = 0; i < count; ++i) {
+      s.key_bytes[s.key_fill++] = buffer[i];
+      if (s.key_fill == s.key_bytes.size()) {
+        s.keystate = s.key_bytes[0] | (s.key_bytes[1] << 8);
+        s.key_fill = 0;
+      }
+    }
+  }
+}
+
+bool game_server::worker::flush(session &s) {
+  while (s.out_pos < s.out.size()) {
+    ssize_t count = send(s.fd, s.out.data() + s.out_pos,
+                         s.out.size() - s.out_pos, MSG_NOSIGNAL);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        return false;
+      }
+      break;
+    }
+    s.out_pos += count;
+  }
+
+  // Only ask for EPOLLOUT while something is stuck in the buffer.
+  bool pending = s.out_pos < s.out.size();
+  if (pending != s.want_write) {
+    epoll_event ev{.events = EPOLLIN | (pending ? EPOLLOUT : 0u),
+                   .data = {.fd = s.fd}};
+    epoll_ctl(m_epoll, EPOLL_CTL_MOD, s.fd, &ev);
+    s.want_write = pending;
+  }
+  return true;
+}
+
+bool game_server::worker::run_frames(session &s, uint64_t frames) {
+  auto &mach = s.machine;
+  for (uint64_t f = 0; f < frames; ++f) {
+    s.frame_end += m_server.m_conf.cycles_per_frame;
+    while (mach.cycles() < s.frame_end) {
+      auto status = mach.step(s.keystate);
+      if (status == statemachine_common::WAITING_FOR_KEYPRESS) {
+        // Nothing changes until the keys do.
+        mach.idle_until(s.frame_end);
+      } else if (status < 0) {
+        LOG_INFO("session {} stopped with error {}", s.fd,
+                 static_cast<int>(status));
+        return false;
+      }
+    }
+  }
+
+  // A client that hasn't drained the previous record skips this frame.
+  if (mach.display_generation() == s.sent_generation ||
+      s.out_pos < s.out.size()) {
+    return true;
+  }
+  auto display = mach.display();
+  s.out.clear();
+  s.out_pos = 0;
+  append_frame_record(s.sent_any ? std::span<const uint8_t>(s.sent)
+                                 : std::span<const uint8_t>(),
+                      display, s.out);
+  s.sent = display;
+  s.sent_any = true;
+  s.sent_generation = mach.display_generation();
+  return flush(s);
+}
+
+void game_server::worker::close_session(int fd) {
+  epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+  close(fd);
+  m_sessions.erase(fd);
+  --m_server.m_sessions;
+}
+
+std::unique_ptr<game_server> game_server::create(const config &conf,
+                                                 rom_ptr rom) {
+  sockaddr_un addr{.sun_family = AF_UNIX};
+  if (conf.socket_path.size() >= sizeof(addr.sun_path)) {
+    LOG_ERROR("socket path {} is too long", conf.socket_path);
+    return nullptr;
+  }
+  std::copy(conf.socket_path.begin(), conf.socket_path.end(), addr.sun_path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    LOG_ERROR("socket failed: {}", std::strerror(errno));
+    return nullptr;
+  }
+  unlink(conf.socket_path.c_str());
+  if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+      listen(fd, SOMAXCONN) != 0) {
+    LOG_ERROR("failed to listen on {}: {}", conf.socket_path,
+              std::strerror(errno));
+    close(fd);
+    return nullptr;
+  }
+
+  std::unique_ptr<game_server> server(
+      new game_server(conf, std::move(rom), fd));
+  for (unsigned i = 0; i < std::max(conf.workers, 1u); ++i) {
+    server->m_workers.push_back(std::make_unique<worker>(*server));
+    if (!server->m_workers.back()->ok()) {
+      return nullptr;
+    }
+  }
+  return server;
+}
+
+game_server::game_server(const config &conf, rom_ptr rom, int listen_fd)
+    : m_conf(conf), m_rom(std::move(rom)), m_listen_fd(listen_fd),
+      m_sessions(0) {}
+
+game_server::~game_server() {
+  m_workers.clear();
+  close(m_listen_fd);
+  unlink(m_conf.socket_path.c_str());
+}
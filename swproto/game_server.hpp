@@ -0,0 +1,68 @@
+#ifndef SWIMP_GAME_SERVER_H
+#define SWIMP_GAME_SERVER_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "memory.hpp"
+#include "statemachine.hpp"
+
+/*
+ * Hosts one machine per client connection on a Unix domain stream socket.
+ *
+ *   on connect:      server sends u16 width, u16 height
+ *   client → server: u16 keystate, as often as it likes; the latest wins
+ *   server → client: a frame record (see video.hpp) whenever the display
+ *                    changed, against the last frame sent to that client
+ *
+ * All integers are little-endian. The first record is a keyframe. The server
+ * closes the connection if the machine reports an error.
+ *
+ * Each worker thread owns the sessions it accepted and runs them all once per
+ * 60Hz tick from its own epoll loop, so sessions never migrate or lock. A
+ * client that doesn't keep up skips frames rather than queueing them: at most
+ * one record is ever buffered per session.
+ */
+class game_server {
+public:
+  using rom_ptr =
+      std::shared_ptr<const rom_image<cow_statemachine::MEMORY_SIZE>>;
+
+  struct config {
+    std::string socket_path;
+    unsigned workers = 2;
+    size_t max_sessions = 4096;
+    uint32_t cycles_per_frame = 700 / 60;
+    bool fuse_instructions = true;
+    /// SO_SNDBUF for client sockets; 0 keeps the system default. Smaller
+    /// buffers make slow clients skip frames sooner instead of lagging.
+    int send_buffer = 0;
+  };
+
+  /// Binds the socket and starts the workers. Returns nullptr on failure.
+  static std::unique_ptr<game_server> create(const config &conf, rom_ptr rom);
+
+  game_server(const game_server &) = delete;
+  game_server &operator=(const game_server &) = delete;
+
+  /// Disconnects everyone, stops the workers and removes the socket.
+  ~game_server();
+
+  inline size_t sessions() const { return m_sessions; };
+
+private:
+  class worker;
+
+  game_server(const config &conf, rom_ptr rom, int listen_fd);
+
+  config m_conf;
+  rom_ptr m_rom;
+  int m_listen_fd;
+  std::atomic<size_t> m_sessions;
+  std::vector<std::unique_ptr<worker>> m_workers;
+};
+
+#endif // SWIMP_GAME_SERVER_H
@@ -0,0 +1,193 @@
+#include <array>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <initializer_list>
+#include <optional>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "font.hpp"
+#include "game_server.hpp"
+#include "rom.hpp"
+#include "video.hpp"
+
+using display_t = std::array<uint8_t, cow_statemachine::DISPLAY_SIZE>;
+
+static game_server::rom_ptr make_rom(std::initializer_list<uint16_t> code) {
+  std::vector<uint8_t> program;
+  for (uint16_t op : code) {
+    program.push_back(op >> 8);
+    program.push_back(op & 0xFF);
+  }
+  return std::make_shared<const rom_image<cow_statemachine::MEMORY_SIZE>>(
+      *load_rom(program));
+}
+
+static std::string socket_path() {
+  return "/tmp/game_server_test_" + std::to_string(getpid()) + ".sock";
+}
+
+/// A blocking client that gives up on reads after a few seconds.
+static int connect_to(const std::string &path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  sockaddr_un addr{.sun_family = AF_UNIX};
+  std::copy(path.begin(), path.end(), addr.sun_path);
+  if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  timeval timeout{.tv_sec = 5, .tv_usec = 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  return fd;
+}
+
+static bool read_exact(int fd, uint8_t *data, size_t size) {
+  while (size > 0) {
+    ssize_t count = recv(fd, data, size, 0);
+    if (count <= 0) {
+      return false;
+    }
+    data += count;
+    size -= count;
+  }
+  return true;
+}
+
+static bool send_keys(int fd, uint16_t keystate) {
+  uint8_t bytes[2] = {static_cast<uint8_t>(keystate & 0xFF),
+                      static_cast<uint8_t>(keystate >> 8)};
+  return send(fd, bytes, sizeof(bytes), MSG_NOSIGNAL) == sizeof(bytes);
+}
+
+/// True if the server greeted us with the display dimensions.
+static bool read_dimensions(int fd) {
+  std::array<uint8_t, 4> header;
+  return read_exact(fd, header.data(), header.size()) &&
+         (header[0] | (header[1] << 8)) == cow_statemachine::DISPLAY_WIDTH &&
+         (header[2] | (header[3] << 8)) == cow_statemachine::DISPLAY_HEIGHT;
+}
+
+/// Reads one frame record and applies it to `frame`. Returns its type.
+static char read_frame(int fd, display_t &frame) {
+  uint8_t type;
+  if (!read_exact(fd, &type, 1)) {
+    return 0;
+  }
+  uint64_t size = 0;
+  for (unsigned shift = 0;; shift += 7) {
+    uint8_t byte;
+    if (shift > 63 || !read_exact(fd, &byte, 1)) {
+      return 0;
+    }
+    size |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      break;
+    }
+  }
+  std::vector<uint8_t> payload(size);
+  if (!read_exact(fd, payload.data(), payload.size())) {
+    return 0;
+  }
+  if (type == 'K') {
+    frame.fill(0);
+  }
+  return apply_frame_payload(payload, frame) ? type : 0;
+}
+
+TEST(GameServerTest, TestKeysAndFrames) {
+  // Draws a 5 once key 5 is down, then a 6 next to it once key 6 is.
+  auto rom = make_rom({
+      0x6000, // V0 = 0
+      0x6305, // V3 = 5
+      0xE39E, // skip if key V3
+      0x1204, // jump back
+      0xF329, // I = font(V3)
+      0xD005, // draw at (0, 0)
+      0x6406, // V4 = 6
+      0xE49E, // skip if key V4
+      0x120E, // jump back
+      0xF429, // I = font(V4)
+      0x6108, // V1 = 8
+      0xD105, // draw at (8, 0)
+      0x1218, // jump to self
+  });
+  auto server = game_server::create({.socket_path = socket_path()}, rom);
+  ASSERT_NE(server, nullptr);
+
+  int fd = connect_to(socket_path());
+  ASSERT_GE(fd, 0);
+  ASSERT_TRUE(read_dimensions(fd));
+
+  display_t frame{}, expected{};
+  ASSERT_TRUE(send_keys(fd, 1 << 5));
+  ASSERT_EQ(read_frame(fd, frame), 'K');
+  for (unsigned row = 0; row < FONT_SPRITE_SIZE; ++row) {
+    expected[row * 8] = font[5 * FONT_SPRITE_SIZE + row];
+  }
+  ASSERT_EQ(frame, expected);
+  ASSERT_EQ(server->sessions(), 1);
+
+  ASSERT_TRUE(send_keys(fd, 1 << 6));
+  ASSERT_EQ(read_frame(fd, frame), 'D');
+  for (unsigned row = 0; row < FONT_SPRITE_SIZE; ++row) {
+    expected[row * 8 + 1] = font[6 * FONT_SPRITE_SIZE + row];
+  }
+  ASSERT_EQ(frame, expected);
+
+  close(fd);
+  for (int i = 0; i < 500 && server->sessions() > 0; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_EQ(server->sessions(), 0);
+}
+
+TEST(GameServerTest, TestSlowClientSkipsFrames) {
+  // Shows a counter in the first display byte, bumped once per timer tick.
+  auto rom = make_rom({
+      0x6101, // V1 = 1
+      0x6300, // V3 = 0
+      0xF207, // V2 = DT
+      0x3200, // skip if V2 == 0
+      0x1204, // jump back
+      0xF115, // DT = V1
+      0x7001, // V0 += 1
+      0xA300, // I = 0x300
+      0xF055, // [I] = V0
+      0xA300, // I = 0x300
+      0x00E0, // clear
+      0xD331, // draw one row at (0, 0)
+      0x1204, // jump to the DT wait
+  });
+  auto server = game_server::create(
+      {.socket_path = socket_path(), .workers = 1, .send_buffer = 4096}, rom);
+  ASSERT_NE(server, nullptr);
+
+  int fd = connect_to(socket_path());
+  ASSERT_GE(fd, 0);
+  ASSERT_TRUE(read_dimensions(fd));
+
+  // A second's worth of frames won't fit in the socket buffer.
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+  ASSERT_EQ(server->sessions(), 1);
+
+  display_t frame{}, expected{};
+  ASSERT_EQ(read_frame(fd, frame), 'K');
+  // Deltas stay valid across the skipped frames, and keep coming after.
+  uint8_t previous = frame[0];
+  std::optional<uint8_t> skipped_to;
+  while (!skipped_to || frame[0] < *skipped_to + 10) {
+    ASSERT_EQ(read_frame(fd, frame), 'D');
+    expected[0] = frame[0];
+    ASSERT_EQ(frame, expected);
+    ASSERT_GT(frame[0], previous);
+    if (!skipped_to && frame[0] > previous + 1) {
+      skipped_to = frame[0];
+    }
+    previous = frame[0];
+  }
+  close(fd);
+}
@@ -0,0 +1,188 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "audio.hpp"
+#include "cycle_costs.hpp"
+#include "log.hpp"
+#include "rom.hpp"
+#include "rom_library.hpp"
+#include "statemachine.hpp"
+#include "terminal.hpp"
+#include "video.hpp"
+
+// Same pacing as the SFML emulator.
+const unsigned FRAMES_PER_SECOND = 60;
+const unsigned CYCLES_PER_FRAME = 700 / FRAMES_PER_SECOND;
+const unsigned SAMPLE_RATE = 44100;
+
+/// Runs a ROM without a window for a fixed number of 60Hz frames.
+int main(int argc, char **argv) {
+  using namespace std;
+
+  string path;
+  optional<string> record_path;
+  optional<string> wav_path;
+  unsigned long frames = 600;
+  optional<terminal_renderer::cells> terminal;
+  bool fuse = true;
+  optional<cycle_costs> costs;
+  bool bad_costs = false;
+  optional<string> library_path;
+  for (int i = 1; i < argc; ++i) {
+    string_view arg = argv[i];
+    if (arg.starts_with("--record=")) {
+      record_path = arg.substr(arg.find('=') + 1);
+    } else if (arg.starts_with("--wav=")) {
+      wav_path = arg.substr(arg.find('=') + 1);
+    } else if (arg.starts_with("--frames=")) {
+      frames = strtoul(argv[i] + arg.find('=') + 1, nullptr, 10);
+    } else if (arg == "--terminal" || arg == "--terminal=half") {
+      terminal = terminal_renderer::cells::HALF_BLOCK;
+    } else if (arg == "--terminal=braille") {
+      terminal = terminal_renderer::cells::BRAILLE;
+    } else if (arg == "--no-fusion") {
+      fuse = false;
+    } else if (arg == "--cost-model=vip") {
+      costs = cycle_costs::cosmac_vip();
+    } else if (arg.starts_with("--cost-model=")) {
+      costs = load_cycle_costs(string(arg.substr(arg.find('=') + 1)));
+      bad_costs = !costs;
+    } else if (arg.starts_with("--library=")) {
+      library_path = arg.substr(arg.find('=') + 1);
+    } else if (!arg.starts_with("--") && path.empty()) {
+      path = arg;
+    } else {
+      path.clear();
+      break;
+    }
+  }
+
+  if (path.empty()) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--frames=<count>] [--record=<file>] [--wav=<file>]"
+                 " [--terminal[=half|braille]] [--no-fusion]"
+                 " [--cost-model=vip|<file>] [--library=<index>]"
+                 " <ROM.ch8 | name in library>\n";
+    return 1;
+  }
+  if (bad_costs) {
+    LOG_ERROR("Failed to read the cost model");
+    return 1;
+  }
+  // A library ROM is already laid out in memory and comes with a profile.
+  rom_profile profile = rom_profile::defaults();
+  shared_ptr<const rom_image<statemachine::MEMORY_SIZE>> image;
+  if (library_path) {
+    auto rom = load_from_library(*library_path, path);
+    if (!rom) {
+      return 1;
+    }
+    image = std::move(rom->image);
+    profile = rom->profile;
+  } else {
+    auto possible_mem = try_load(path);
+    if (!possible_mem.has_value()) {
+      LOG_ERROR("Failed to open {}", path);
+      return 1;
+    }
+    image = make_shared<const rom_image<statemachine::MEMORY_SIZE>>(
+        *possible_mem);
+  }
+
+  // With a cost model a frame is that interpreter's cycles per frame rather
+  // than a fixed number of instructions; otherwise the profile may set it.
+  uint32_t cycles_per_frame = CYCLES_PER_FRAME;
+  if (costs) {
+    cycles_per_frame = costs->cycles_per_frame;
+  } else if (profile.cycles_per_frame) {
+    cycles_per_frame = profile.cycles_per_frame;
+  }
+
+  statemachine::init_conf conf{
+      .pc = 0x200,
+      .font_begin = 0x000,
+      .fuse_instructions = fuse,
+      .costs = costs ? &*costs : nullptr,
+  };
+  profile.apply(conf);
+  conf.cycles_per_tick = cycles_per_frame;
+  statemachine machine(*image, conf);
+
+  auto recorder = record_path ? video_writer::create(
+                                    *record_path, statemachine::DISPLAY_WIDTH,
+                                    statemachine::DISPLAY_HEIGHT)
+                              : nullopt;
+  if (record_path && !recorder) {
+    LOG_ERROR("Failed to create {}", *record_path);
+    return 1;
+  }
+
+  // Headless runs go much faster than real time, so give the WAV writer
+  // plenty of slack. A file must not lose samples, so emulation waits for
+  // the writer whenever the ring does fill up.
+  spsc_ring<int16_t> audio_ring(SAMPLE_RATE * 4);
+  audio_generator audio(audio_ring, SAMPLE_RATE,
+                        cycles_per_frame * FRAMES_PER_SECOND,
+                        audio_generator::when_full::WAIT);
+  unique_ptr<wav_sink> wav;
+  if (wav_path) {
+    wav = wav_sink::create(*wav_path, audio_ring, SAMPLE_RATE);
+    if (!wav) {
+      LOG_ERROR("Failed to create {}", *wav_path);
+      return 1;
+    }
+  }
+
+  // Drawing to a terminal paces the run at 60Hz so that it can be watched.
+  unique_ptr<terminal_renderer> screen;
+  if (terminal) {
+    screen = make_unique<terminal_renderer>(
+        statemachine::DISPLAY_WIDTH, statemachine::DISPLAY_HEIGHT, *terminal);
+  }
+  auto next_frame = chrono::steady_clock::now();
+
+  for (unsigned long frame = 0; frame < frames; ++frame) {
+    // A step may overrun the frame by an instruction or two; budgeting from
+    // the start of the run keeps that from accumulating.
+    uint64_t frame_end = (frame + 1) * cycles_per_frame;
+    while (machine.cycles() < frame_end) {
+      auto status = machine.step(0);
+      if (status < 0) {
+        LOG_ERROR("machine reported error {} in frame {}",
+                  static_cast<int>(status), frame);
+        return 1;
+      }
+      if (wav) {
+        audio.observe(machine);
+      }
+    }
+    if (wav) {
+      audio.render_until(machine.cycles());
+    }
+    if (recorder) {
+      recorder->write_frame(machine.display());
+    }
+    if (screen) {
+      screen->draw(machine.display());
+      next_frame += chrono::microseconds(1000000 / FRAMES_PER_SECOND);
+      this_thread::sleep_until(next_frame);
+    }
+  }
+  if (screen) {
+    uint64_t bytes = screen->bytes_written();
+    screen.reset();
+    LOG_INFO("Wrote {} bytes to the terminal", bytes);
+  }
+
+  LOG_INFO("Ran {} frames ({} cycles)", frames, machine.cycles());
+  if (audio.dropped()) {
+    LOG_WARN("Dropped {} audio samples", audio.dropped());
+  }
+  return 0;
+}
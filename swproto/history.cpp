@@ -0,0 +1,133 @@
+#include <algorithm>
+
+#include "history.hpp"
+
+execution_history::execution_history(statemachine &mach,
+                                     uint64_t checkpoint_interval)
+    : m_mach(mach), m_interval(std::max<uint64_t>(checkpoint_interval, 1)),
+      m_next_checkpoint(mach.cycles() + m_interval), m_steps(0),
+      m_keystate(0) {
+  m_checkpoints.push_back(
+      {.mach = mach, .steps = 0, .inputs = 0, .keystate = 0});
+}
+
+statemachine_common::status execution_history::step(uint16_t keystate) {
+  uint64_t before = m_mach.cycles();
+  uint16_t opcode = m_mach.pc() + 1u < statemachine::MEMORY_SIZE
+                        ? m_mach.curr_instruction()
+                        : 0;
+  uint16_t reg_I = m_mach.reg_I();
+  std::array<uint8_t, 16> regs;
+  std::copy(m_mach.regs().begin(), m_mach.regs().end(), regs.begin());
+  uint64_t display_generation = m_mach.display_generation();
+
+  if (keystate != m_keystate) {
+    m_inputs.push_back({.step = m_steps, .value = keystate, .idle = false});
+    m_keystate = keystate;
+  }
+  auto status = m_mach.step(keystate);
+  // Steps that execute nothing are counted too, so that replay matches.
+  ++m_steps;
+  uint64_t after = m_mach.cycles();
+  if (after == before) {
+    // Nothing was executed (a breakpoint or an error).
+    return status;
+  }
+
+  // Only Fx33 and Fx55 write memory, and fusion never puts either of them
+  // anywhere but first.
+  unsigned written = 0;
+  if ((opcode & 0xF0FF) == 0xF033) {
+    written = 3;
+  } else if ((opcode & 0xF0FF) == 0xF055) {
+    written = ((opcode >> 8) & 0xF) + 1;
+  }
+  for (unsigned i = 0; i < written; ++i) {
+    m_writes[(reg_I + i) & statemachine::ADDRESS_MASK].push_back(after);
+  }
+
+  auto now = m_mach.regs();
+  for (unsigned r = 0; r < regs.size(); ++r) {
+    if (now[r] != regs[r]) {
+      m_register_changes[r * 256 + now[r]].push_back(after);
+    }
+  }
+  if (m_mach.display_generation() != display_generation) {
+    m_display_changes.push_back(after);
+  }
+
+  maybe_checkpoint();
+  return status;
+}
+
+void execution_history::idle_until(uint64_t cycle) {
+  m_inputs.push_back({.step = m_steps, .value = cycle, .idle = true});
+  m_mach.idle_until(cycle);
+  maybe_checkpoint();
+}
+
+void execution_history::maybe_checkpoint() {
+  if (m_mach.cycles() >= m_next_checkpoint) {
+    m_checkpoints.push_back({.mach = m_mach,
+                             .steps = m_steps,
+                             .inputs = m_inputs.size(),
+                             .keystate = m_keystate});
+    m_next_checkpoint = m_mach.cycles() + m_interval;
+  }
+}
+
+std::optional<uint64_t>
+execution_history::last_before(const std::vector<uint64_t> &list,
+                               uint64_t before) {
+  auto it = std::upper_bound(list.begin(), list.end(), before);
+  if (it == list.begin()) {
+    return std::nullopt;
+  }
+  return *(it - 1);
+}
+
+std::optional<uint64_t> execution_history::last_write(uint16_t addr,
+                                                      uint64_t before) const {
+  return last_before(m_writes[addr & statemachine::ADDRESS_MASK], before);
+}
+
+std::optional<uint64_t>
+execution_history::last_register_change(uint8_t reg, uint8_t value,
+                                        uint64_t before) const {
+  return last_before(m_register_changes.at(reg * 256 + value), before);
+}
+
+std::optional<uint64_t>
+execution_history::last_display_change(uint64_t before) const {
+  return last_before(m_display_changes, before);
+}
+
+statemachine execution_history::restore(uint64_t cycle) const {
+  // The last checkpoint at or before `cycle`; the first one is at the start.
+  auto it = std::upper_bound(m_checkpoints.begin(), m_checkpoints.end(), cycle,
+                             [](uint64_t cycle, const checkpoint &c) {
+                               return cycle < c.mach.cycles();
+                             });
+  const checkpoint &from = it == m_checkpoints.begin() ? *it : *(it - 1);
+
+  statemachine mach = from.mach;
+  uint64_t steps = from.steps;
+  uint16_t keystate = from.keystate;
+  size_t next = from.inputs;
+  while (mach.cycles() < cycle) {
+    if (next < m_inputs.size() && m_inputs[next].step == steps) {
+      const input &in = m_inputs[next++];
+      if (in.idle) {
+        mach.idle_until(std::min(in.value, cycle));
+      } else {
+        keystate = in.value;
+      }
+    } else if (steps < m_steps) {
+      mach.step(keystate);
+      ++steps;
+    } else {
+      break;
+    }
+  }
+  return mach;
+}
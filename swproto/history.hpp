@@ -0,0 +1,101 @@
+#ifndef SWIMP_HISTORY_H
+#define SWIMP_HISTORY_H
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "statemachine.hpp"
+
+/**
+ * Records a machine's execution so that past states can be inspected without
+ * rerunning it from reset.
+ *
+ * Drive the machine through step() and idle_until() here instead of calling
+ * it directly. The history keeps a full copy of the machine every
+ * `checkpoint_interval` cycles, every change of keystate and every idle, and
+ * indexes of every memory write (Fx33/Fx55), every change of a V register and
+ * every display change, each keyed by cycles() right after the step that
+ * caused it.
+ *
+ * Queries binary-search those indexes. restore() copies the nearest earlier
+ * checkpoint and replays from there, so it never replays more than one
+ * interval. Memory use is one machine per interval, 8 bytes per indexed
+ * event (most steps change at least one register) and 24 bytes per keystate
+ * change or idle. Steps that keep the keys as they were cost nothing extra.
+ */
+class execution_history {
+public:
+  const static uint64_t NEVER = UINT64_MAX;
+
+  execution_history(statemachine &mach, uint64_t checkpoint_interval = 10000);
+
+  /// Steps the machine, recording the step.
+  statemachine_common::status step(uint16_t keystate);
+
+  /// Calls idle_until() on the machine, recording the call.
+  void idle_until(uint64_t cycle);
+
+  /// The last step that wrote `addr`, if it finished by `before`.
+  std::optional<uint64_t> last_write(uint16_t addr,
+                                     uint64_t before = NEVER) const;
+
+  /// The last step by `before` that changed register `reg` to `value`.
+  std::optional<uint64_t> last_register_change(uint8_t reg, uint8_t value,
+                                               uint64_t before = NEVER) const;
+
+  /// The last step by `before` that changed the display.
+  std::optional<uint64_t> last_display_change(uint64_t before = NEVER) const;
+
+  /**
+   * Reconstructs the machine as it was at the first step boundary at or after
+   * `cycle`, or as it is now if that's later than anything recorded.
+   * Fused steps retire several cycles at once, so the result can be a few
+   * cycles past `cycle`.
+   */
+  statemachine restore(uint64_t cycle) const;
+
+  inline size_t checkpoints() const { return m_checkpoints.size(); };
+
+private:
+  /// A change of keystate or an idle, in the order they happened.
+  struct input {
+    /// Number of steps taken before it.
+    uint64_t step;
+    /// For a keystate change, the new keystate; for an idle, the cycle to
+    /// idle until.
+    uint64_t value;
+    bool idle;
+  };
+
+  struct checkpoint {
+    statemachine mach;
+    /// Steps taken, inputs recorded and the keystate when the copy was taken.
+    uint64_t steps;
+    size_t inputs;
+    uint16_t keystate;
+  };
+
+  /// Returns the last entry of a sorted list that is <= before.
+  static std::optional<uint64_t> last_before(const std::vector<uint64_t> &list,
+                                             uint64_t before);
+
+  /// Takes a checkpoint if the machine has run past the next one.
+  void maybe_checkpoint();
+
+  statemachine &m_mach;
+  uint64_t m_interval;
+  uint64_t m_next_checkpoint;
+  std::vector<checkpoint> m_checkpoints;
+  std::vector<input> m_inputs;
+  uint64_t m_steps;
+  uint16_t m_keystate;
+
+  std::array<std::vector<uint64_t>, statemachine::MEMORY_SIZE> m_writes;
+  /// Indexed by register * 256 + value.
+  std::array<std::vector<uint64_t>, 16 * 256> m_register_changes;
+  std::vector<uint64_t> m_display_changes;
+};
+
+#endif // SWIMP_HISTORY_H
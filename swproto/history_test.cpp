@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include "history.hpp"
+
+TEST(HistoryTest, TestQueries) {
+  statemachine machine(
+      {
+          0xA100, // LD I, 0x100
+          0x7001, // ADD V0, 1
+          0xF055, // LD [I], V0
+          0x3005, // SE V0, 5
+          0x1002, // JP 0x002
+          0x6F01, // LD VF, 1
+          0xD015, // DRW V0, V1, 5
+          0xF10A, // LD V1, K
+      },
+      {.quirk_load_store = true});
+  execution_history history(machine, 4);
+  while (history.step(0) != statemachine_common::WAITING_FOR_KEYPRESS) {
+  }
+  history.idle_until(100);
+  ASSERT_EQ(machine.cycles(), 100);
+  ASSERT_GT(history.checkpoints(), 2);
+
+  // Each pass of the loop takes 4 cycles and stores V0 on its second.
+  ASSERT_EQ(history.last_write(0x100), 19);
+  ASSERT_EQ(history.last_write(0x100, 18), 15);
+  ASSERT_EQ(history.last_write(0x100, 2), std::nullopt);
+  ASSERT_EQ(history.last_write(0x101), std::nullopt);
+  ASSERT_EQ(history.last_register_change(0, 3), 10);
+  ASSERT_EQ(history.last_register_change(0xF, 1), 21);
+  ASSERT_EQ(history.last_register_change(0xF, 0), 22);
+  ASSERT_EQ(history.last_display_change(), 22);
+  ASSERT_EQ(history.last_display_change(21), std::nullopt);
+
+  for (uint64_t cycle : {0, 1, 10, 17, 21, 22, 23, 50, 100}) {
+    statemachine replayed(
+        {0xA100, 0x7001, 0xF055, 0x3005, 0x1002, 0x6F01, 0xD015, 0xF10A},
+        {.quirk_load_store = true});
+    while (replayed.cycles() < std::min<uint64_t>(cycle, 23)) {
+      replayed.step(0);
+    }
+    replayed.idle_until(cycle);
+    statemachine restored = history.restore(cycle);
+    ASSERT_EQ(restored.cycles(), cycle);
+    ASSERT_EQ(restored.state_hash(), replayed.state_hash()) << cycle;
+  }
+}
+
+TEST(HistoryTest, TestRestoreReplaysKeyChanges) {
+  std::initializer_list<uint16_t> program = {
+      0x6105, // LD V1, 5
+      0xE1A1, // SKNP V1
+      0x7001, // ADD V0, 1
+      0x1002, // JP 0x002
+  };
+  // Key 5 goes down and up every seven steps.
+  auto keys = [](uint64_t step) -> uint16_t {
+    return (step / 7) % 2 ? 1 << 5 : 0;
+  };
+  statemachine machine(program);
+  execution_history history(machine, 16);
+  for (uint64_t step = 0; step < 200; ++step) {
+    history.step(keys(step));
+  }
+  ASSERT_GT(machine.regs()[0], 0);
+
+  for (uint64_t cycle : {0, 5, 16, 33, 99, 150, 199, 200}) {
+    statemachine replayed(program);
+    for (uint64_t step = 0; replayed.cycles() < cycle; ++step) {
+      replayed.step(keys(step));
+    }
+    statemachine restored = history.restore(cycle);
+    ASSERT_EQ(restored.cycles(), cycle);
+    ASSERT_EQ(restored.state_hash(), replayed.state_hash()) << cycle;
+  }
+}
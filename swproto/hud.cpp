@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+#include "hud.hpp"
+
+/// How often the numbers are refreshed; anything faster is unreadable.
+static const std::chrono::milliseconds UPDATE_INTERVAL(500);
+
+/// Rows of a 3x5 glyph, leftmost pixel in bit 2. Unknown characters are
+/// blank.
+static std::array<uint8_t, 5> glyph(char c) {
+  switch (c) {
+  case '0':
+    return {0b111, 0b101, 0b101, 0b101, 0b111};
+  case '1':
+    return {0b010, 0b110, 0b010, 0b010, 0b111};
+  case '2':
+    return {0b111, 0b001, 0b111, 0b100, 0b111};
+  case '3':
+    return {0b111, 0b001, 0b111, 0b001, 0b111};
+  case '4':
+    return {0b101, 0b101, 0b111, 0b001, 0b001};
+  case '5':
+    return {0b111, 0b100, 0b111, 0b001, 0b111};
+  case '6':
+    return {0b111, 0b100, 0b111, 0b101, 0b111};
+  case '7':
+    return {0b111, 0b001, 0b001, 0b001, 0b001};
+  case '8':
+    return {0b111, 0b101, 0b111, 0b101, 0b111};
+  case '9':
+    return {0b111, 0b101, 0b111, 0b001, 0b111};
+  case 'A':
+    return {0b010, 0b101, 0b111, 0b101, 0b101};
+  case 'B':
+    return {0b110, 0b101, 0b110, 0b101, 0b110};
+  case 'C':
+    return {0b011, 0b100, 0b100, 0b100, 0b011};
+  case 'D':
+    return {0b110, 0b101, 0b101, 0b101, 0b110};
+  case 'E':
+    return {0b111, 0b100, 0b110, 0b100, 0b111};
+  case 'F':
+    return {0b111, 0b100, 0b110, 0b100, 0b100};
+  case 'G':
+    return {0b011, 0b100, 0b101, 0b101, 0b011};
+  case 'H':
+    return {0b101, 0b101, 0b111, 0b101, 0b101};
+  case 'I':
+    return {0b111, 0b010, 0b010, 0b010, 0b111};
+  case 'J':
+    return {0b001, 0b001, 0b001, 0b101, 0b010};
+  case 'K':
+    return {0b101, 0b101, 0b110, 0b101, 0b101};
+  case 'L':
+    return {0b100, 0b100, 0b100, 0b100, 0b111};
+  case 'M':
+    return {0b101, 0b111, 0b111, 0b101, 0b101};
+  case 'N':
+    return {0b110, 0b101, 0b101, 0b101, 0b101};
+  case 'O':
+    return {0b010, 0b101, 0b101, 0b101, 0b010};
+  case 'P':
+    return {0b110, 0b101, 0b110, 0b100, 0b100};
+  case 'Q':
+    return {0b010, 0b101, 0b101, 0b110, 0b011};
+  case 'R':
+    return {0b110, 0b101, 0b110, 0b101, 0b101};
+  case 'S':
+    return {0b011, 0b100, 0b010, 0b001, 0b110};
+  case 'T':
+    return {0b111, 0b010, 0b010, 0b010, 0b010};
+  case 'U':
+    return {0b101, 0b101, 0b101, 0b101, 0b111};
+  case 'V':
+    return {0b101, 0b101, 0b101, 0b101, 0b010};
+  case 'W':
+    return {0b101, 0b101, 0b111, 0b111, 0b101};
+  case 'X':
+    return {0b101, 0b101, 0b010, 0b101, 0b101};
+  case 'Y':
+    return {0b101, 0b101, 0b010, 0b010, 0b010};
+  case 'Z':
+    return {0b111, 0b001, 0b010, 0b100, 0b111};
+  case '%':
+    return {0b101, 0b001, 0b010, 0b100, 0b101};
+  case '-':
+    return {0b000, 0b000, 0b111, 0b000, 0b000};
+  case '.':
+    return {0b000, 0b000, 0b000, 0b000, 0b010};
+  case '/':
+    return {0b001, 0b001, 0b010, 0b100, 0b100};
+  default:
+    return {0, 0, 0, 0, 0};
+  }
+}
+
+static double seconds(perf_hud::clock::duration d) {
+  return std::chrono::duration<double>(d).count();
+}
+
+static std::string status_text(statemachine_common::status status) {
+  switch (status) {
+  case statemachine_common::NO_ERROR:
+    return "RUNNING";
+  case statemachine_common::WAITING_FOR_KEYPRESS:
+    return "WAITING FOR KEY";
+  case statemachine_common::NOT_IMPLEMENTED:
+    return "NOT IMPLEMENTED";
+  case statemachine_common::BREAKPOINT:
+    return "BREAKPOINT";
+  case statemachine_common::WATCHPOINT:
+    return "WATCHPOINT";
+  default:
+    return "ERROR " + std::to_string(static_cast<int>(status));
+  }
+}
+
+perf_hud::perf_hud(float pixel_size, bool counts_cycles)
+    : m_pixel_size(pixel_size), m_counts_cycles(counts_cycles),
+      m_visible(false),
+      m_status(statemachine_common::NO_ERROR), m_frame_begin(),
+      m_emulated(), m_window_begin(clock::now()), m_window_cycles(0),
+      m_cycles(0), m_frames(0), m_frame_sum(0), m_frame_sq_sum(0),
+      m_emulate_sum(0), m_draw_sum(0), m_quads(sf::Quads) {
+  m_background.setFillColor(sf::Color(0, 0, 0, 160));
+  update_text(m_window_begin);
+}
+
+void perf_hud::frame_begin() {
+  auto now = clock::now();
+  if (m_frame_begin != clock::time_point()) {
+    double frame = seconds(now - m_frame_begin);
+    ++m_frames;
+    m_frame_sum += frame;
+    m_frame_sq_sum += frame * frame;
+  }
+  m_frame_begin = now;
+  if (now - m_window_begin >= UPDATE_INTERVAL) {
+    update_text(now);
+  }
+}
+
+void perf_hud::emulated(uint64_t cycles) {
+  m_emulated = clock::now();
+  m_emulate_sum += seconds(m_emulated - m_frame_begin);
+  m_cycles = cycles;
+}
+
+void perf_hud::draw(sf::RenderTarget &target) {
+  if (m_visible) {
+    target.draw(m_background);
+    target.draw(m_quads);
+  }
+  m_draw_sum += seconds(clock::now() - m_emulated);
+}
+
+void perf_hud::update_text(clock::time_point now) {
+  using namespace std;
+  double elapsed = seconds(now - m_window_begin);
+  double frame_mean = m_frames ? m_frame_sum / m_frames : 0;
+  double jitter =
+      m_frames ? sqrt(max(m_frame_sq_sum / m_frames - frame_mean * frame_mean,
+                          0.0))
+               : 0;
+  double busy = m_frame_sum > 0 ? (m_emulate_sum + m_draw_sum) / m_frame_sum
+                                : 0;
+
+  auto line = [](auto... parts) {
+    stringstream ss;
+    ss << fixed << setprecision(2);
+    (ss << ... << parts);
+    return ss.str();
+  };
+  m_text = {
+      line(m_counts_cycles ? "CYCLES/S " : "IPS ",
+           static_cast<uint64_t>(elapsed > 0
+                                     ? (m_cycles - m_window_cycles) / elapsed
+                                     : 0)),
+      line("FRAME ", frame_mean * 1000, " MS"),
+      line("JITTER ", jitter * 1000, " MS"),
+      line("EMULATE ", m_frames ? m_emulate_sum * 1000 / m_frames : 0, " MS"),
+      line("DRAW ", m_frames ? m_draw_sum * 1000 / m_frames : 0, " MS"),
+      line("IDLE ", static_cast<int>(max(1 - busy, 0.0) * 100), "%"),
+      status_text(m_status),
+  };
+
+  m_quads.clear();
+  size_t columns = 0;
+  for (unsigned row = 0; row < m_text.size(); ++row) {
+    append_line(m_text[row], row);
+    columns = max(columns, m_text[row].size());
+  }
+  // One pixel of margin around the text, and one between lines and glyphs.
+  m_background.setSize(
+      sf::Vector2f((columns * (GLYPH_WIDTH + 1) + 1) * m_pixel_size,
+                   (m_text.size() * (GLYPH_HEIGHT + 1) + 1) * m_pixel_size));
+
+  m_window_begin = now;
+  m_window_cycles = m_cycles;
+  m_frames = 0;
+  m_frame_sum = m_frame_sq_sum = m_emulate_sum = m_draw_sum = 0;
+}
+
+void perf_hud::append_line(const std::string &line, unsigned row) {
+  for (size_t column = 0; column < line.size(); ++column) {
+    auto rows = glyph(line[column]);
+    for (unsigned y = 0; y < GLYPH_HEIGHT; ++y) {
+      for (unsigned x = 0; x < GLYPH_WIDTH; ++x) {
+        if (!(rows[y] & (0b100 >> x))) {
+          continue;
+        }
+        float left = (1 + column * (GLYPH_WIDTH + 1) + x) * m_pixel_size;
+        float top = (1 + row * (GLYPH_HEIGHT + 1) + y) * m_pixel_size;
+        float right = left + m_pixel_size;
+        float bottom = top + m_pixel_size;
+        for (auto corner : {sf::Vector2f(left, top), sf::Vector2f(right, top),
+                            sf::Vector2f(right, bottom),
+                            sf::Vector2f(left, bottom)}) {
+          m_quads.append(sf::Vertex(corner, sf::Color::Yellow));
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,85 @@
+#ifndef SWIMP_HUD_H
+#define SWIMP_HUD_H
+
+#include <SFML/Graphics.hpp>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "statemachine.hpp"
+
+/**
+ * On-screen performance overlay for the SFML frontend.
+ *
+ * Each host frame is split into the time spent emulating, the time spent
+ * drawing and whatever is left, which is idle (mostly waiting in display()
+ * for the frame rate limit). Every half second the overlay shows averages of
+ * those, the guest's instructions (or cost-model cycles) per second, the host
+ * frame time and its jitter (standard deviation), and the machine's last
+ * status.
+ *
+ * Text is drawn with a built-in 3x5 pixel font on top of the window after the
+ * guest's pixels, so the machine's display itself is never touched.
+ */
+class perf_hud {
+public:
+  using clock = std::chrono::steady_clock;
+
+  /// @param pixel_size Size in window pixels of one pixel of the HUD font.
+  /// @param counts_cycles Whether the machine's cycles() are cost-model
+  /// cycles rather than instructions, which relabels the rate.
+  explicit perf_hud(float pixel_size, bool counts_cycles = false);
+
+  inline void toggle() { m_visible = !m_visible; };
+
+  inline bool visible() const { return m_visible; };
+
+  /// Call at the start of every host frame.
+  void frame_begin();
+
+  /// Call once the frame's emulation is done, with the machine's cycles().
+  void emulated(uint64_t cycles);
+
+  /// Call with the status of every step.
+  inline void observe(statemachine_common::status status) {
+    m_status = status;
+  };
+
+  /// Draws the overlay if it is visible, and closes the frame's drawing time.
+  void draw(sf::RenderTarget &target);
+
+private:
+  const static unsigned GLYPH_WIDTH = 3;
+  const static unsigned GLYPH_HEIGHT = 5;
+
+  /// Rebuilds m_text from the current window and starts a new one.
+  void update_text(clock::time_point now);
+
+  /// Appends quads for `line` at text row `row`.
+  void append_line(const std::string &line, unsigned row);
+
+  float m_pixel_size;
+  bool m_counts_cycles;
+  bool m_visible;
+  statemachine_common::status m_status;
+
+  clock::time_point m_frame_begin;
+  clock::time_point m_emulated;
+  clock::time_point m_window_begin;
+  uint64_t m_window_cycles;
+  uint64_t m_cycles;
+
+  // Sums over the current window, in seconds.
+  unsigned m_frames;
+  double m_frame_sum;
+  double m_frame_sq_sum;
+  double m_emulate_sum;
+  double m_draw_sum;
+
+  std::vector<std::string> m_text;
+  sf::VertexArray m_quads;
+  sf::RectangleShape m_background;
+};
+
+#endif // SWIMP_HUD_H
@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <bit>
+#include <iomanip>
+
+#include "latency.hpp"
+
+static uint64_t micros(latency_tracker::clock::duration d) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+void latency_tracker::histogram::add(uint64_t value) {
+  // Bucket i holds values in [2^(i-1), 2^i), bucket 0 holds only 0.
+  unsigned bucket = std::min<unsigned>(std::bit_width(value), BUCKETS - 1);
+  ++m_buckets[bucket];
+  ++m_count;
+  m_sum += value;
+  m_max = std::max(m_max, value);
+}
+
+void latency_tracker::histogram::print(std::ostream &os, const char *name,
+                                       const char *unit) const {
+  using namespace std;
+  os << name << ": n=" << m_count;
+  if (m_count == 0) {
+    os << '\n';
+    return;
+  }
+  os << " mean=" << (m_sum / m_count) << unit << " max=" << m_max << unit
+     << '\n';
+
+  uint64_t peak = *max_element(m_buckets.begin(), m_buckets.end());
+  for (unsigned i = 0; i < BUCKETS; ++i) {
+    if (m_buckets[i] == 0) {
+      continue;
+    }
+    uint64_t lower = i ? (uint64_t{1} << (i - 1)) : 0;
+    os << "  >=" << setw(9) << lower << unit << ' ' << setw(7) << m_buckets[i]
+       << ' ' << string((m_buckets[i] * 40 + peak - 1) / peak, '#') << '\n';
+  }
+}
+
+latency_tracker::latency_tracker(uint64_t timeout)
+    : m_unobserved(0), m_undrawn(0), m_last_generation(0), m_step_cycle(0),
+      m_timeout(timeout), m_never_observed(0), m_never_drawn(0) {}
+
+void latency_tracker::key_event(uint16_t old_keystate, uint16_t new_keystate,
+                                const statemachine &mach) {
+  auto now = clock::now();
+  for (uint16_t changed = old_keystate ^ new_keystate; changed;
+       changed &= changed - 1) {
+    if (m_pending.size() == MAX_PENDING) {
+      auto &oldest = m_pending.front();
+      if (oldest.stage == transition::DELIVERED) {
+        --m_unobserved;
+        ++m_never_observed;
+      } else if (oldest.stage == transition::OBSERVED) {
+        --m_undrawn;
+        ++m_never_drawn;
+      }
+      m_pending.pop_front();
+    }
+    m_pending.push_back({.stage = transition::DELIVERED,
+                         .key = static_cast<uint8_t>(std::countr_zero(changed)),
+                         .delivered = now,
+                         .delivered_cycle = mach.cycles()});
+    ++m_unobserved;
+  }
+}
+
+void latency_tracker::observe(const statemachine &mach) {
+  uint16_t opcode = mach.curr_instruction();
+  uint8_t kk = opcode & 0xFF;
+  bool any_key;
+  if ((opcode >> 12) == 0xE && (kk == 0x9E || kk == 0xA1)) {
+    any_key = false;
+  } else if ((opcode >> 12) == 0xF && kk == 0x0A) {
+    any_key = true;
+  } else {
+    return;
+  }
+  uint8_t polled = mach.regs()[(opcode >> 8) & 0xF];
+
+  auto now = clock::now();
+  for (auto &t : m_pending) {
+    if (t.stage != transition::DELIVERED || !(any_key || t.key == polled)) {
+      continue;
+    }
+    t.stage = transition::OBSERVED;
+    t.observed = now;
+    t.observed_cycle = mach.cycles();
+    --m_unobserved;
+    ++m_undrawn;
+  }
+  m_last_generation = mach.display_generation();
+}
+
+void latency_tracker::drawn(const statemachine &mach) {
+  auto now = clock::now();
+  for (auto &t : m_pending) {
+    if (t.stage != transition::OBSERVED) {
+      continue;
+    }
+    t.stage = transition::DRAWN;
+    t.drawn = now;
+    // The cycle counter has already moved past the drawing instruction, by
+    // however many cycles it cost.
+    t.drawn_cycle = m_step_cycle;
+  }
+  m_undrawn = 0;
+  m_last_generation = mach.display_generation();
+}
+
+void latency_tracker::frame_presented(const statemachine &mach) {
+  auto now = clock::now();
+  uint64_t cycle = mach.cycles();
+
+  std::erase_if(m_pending, [&](const transition &t) {
+    switch (t.stage) {
+    case transition::DELIVERED:
+      if (cycle - t.delivered_cycle <= m_timeout) {
+        return false;
+      }
+      --m_unobserved;
+      ++m_never_observed;
+      return true;
+
+    case transition::OBSERVED:
+      if (cycle - t.observed_cycle <= m_timeout) {
+        return false;
+      }
+      --m_undrawn;
+      ++m_never_drawn;
+      return true;
+
+    case transition::DRAWN:
+      m_deliver_to_observe_us.add(micros(t.observed - t.delivered));
+      m_deliver_to_observe_cycles.add(t.observed_cycle - t.delivered_cycle);
+      m_observe_to_draw_us.add(micros(t.drawn - t.observed));
+      m_observe_to_draw_cycles.add(t.drawn_cycle - t.observed_cycle);
+      m_draw_to_present_us.add(micros(now - t.drawn));
+      m_total_us.add(micros(now - t.delivered));
+      return true;
+    }
+    return false;
+  });
+}
+
+void latency_tracker::report(std::ostream &os) const {
+  os << "input latency (" << m_total_us.count() << " transitions displayed, "
+     << m_never_observed << " never observed, " << m_never_drawn
+     << " observed without display change)\n";
+  m_deliver_to_observe_us.print(os, "delivered -> observed", "us");
+  m_deliver_to_observe_cycles.print(os, "delivered -> observed", "cyc");
+  m_observe_to_draw_us.print(os, "observed -> drawn", "us");
+  m_observe_to_draw_cycles.print(os, "observed -> drawn", "cyc");
+  m_draw_to_present_us.print(os, "drawn -> presented", "us");
+  m_total_us.print(os, "delivered -> presented", "us");
+}
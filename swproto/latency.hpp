@@ -0,0 +1,114 @@
+#ifndef SWIMP_LATENCY_H
+#define SWIMP_LATENCY_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <ostream>
+
+#include "statemachine.hpp"
+
+/**
+ * Measures input-to-display latency.
+ *
+ * Every key transition delivered by the host is followed through four points:
+ * when the host delivered it, when the guest first observed it with
+ * Ex9E/ExA1/Fx0A, when the first following 00E0/Dxyn changed the display and
+ * when the frame containing that change was presented. The gaps between them
+ * are accumulated in histograms, which separates scheduling delay (delivery to
+ * observation) from game logic (observation to draw) and rendering delay (draw
+ * to present).
+ */
+class latency_tracker {
+public:
+  using clock = std::chrono::steady_clock;
+
+  /// Histogram with power-of-two buckets.
+  class histogram {
+  public:
+    const static unsigned BUCKETS = 32;
+
+    void add(uint64_t value);
+
+    inline uint64_t count() const { return m_count; };
+
+    void print(std::ostream &os, const char *name, const char *unit) const;
+
+  private:
+    std::array<uint64_t, BUCKETS> m_buckets{};
+    uint64_t m_count = 0;
+    uint64_t m_sum = 0;
+    uint64_t m_max = 0;
+  };
+
+  /**
+   * @param timeout Number of cycles after which a transition that hasn't been
+   * observed, or that was observed but hasn't changed the display, is dropped.
+   * Pass about a second's worth of the machine's cycles; the default is one
+   * second at 700 instructions per second.
+   */
+  latency_tracker(uint64_t timeout = 700);
+
+  /// Call whenever the host delivers a change of keystate.
+  void key_event(uint16_t old_keystate, uint16_t new_keystate,
+                 const statemachine &mach);
+
+  /// Call right before every machine step.
+  inline void before_step(const statemachine &mach) {
+    if (m_unobserved) [[unlikely]] {
+      observe(mach);
+    }
+    m_step_cycle = mach.cycles();
+  }
+
+  /// Call right after every machine step.
+  inline void after_step(const statemachine &mach) {
+    if (m_undrawn && mach.display_generation() != m_last_generation)
+        [[unlikely]] {
+      drawn(mach);
+    }
+  }
+
+  /// Call once the frame has been shown to the player.
+  void frame_presented(const statemachine &mach);
+
+  /// Print all histograms.
+  void report(std::ostream &os) const;
+
+private:
+  const static unsigned MAX_PENDING = 64;
+
+  struct transition {
+    enum stage { DELIVERED, OBSERVED, DRAWN } stage;
+    uint8_t key;
+    clock::time_point delivered;
+    clock::time_point observed;
+    clock::time_point drawn;
+    uint64_t delivered_cycle;
+    uint64_t observed_cycle;
+    uint64_t drawn_cycle;
+  };
+
+  void observe(const statemachine &mach);
+  void drawn(const statemachine &mach);
+
+  std::deque<transition> m_pending;
+  unsigned m_unobserved;
+  unsigned m_undrawn;
+  uint64_t m_last_generation;
+  /// cycles() before the current step, which is when anything it drew began.
+  uint64_t m_step_cycle;
+  uint64_t m_timeout;
+  uint64_t m_never_observed;
+  uint64_t m_never_drawn;
+
+  histogram m_deliver_to_observe_us;
+  histogram m_deliver_to_observe_cycles;
+  histogram m_observe_to_draw_us;
+  histogram m_observe_to_draw_cycles;
+  histogram m_draw_to_present_us;
+  histogram m_total_us;
+};
+
+#endif // SWIMP_LATENCY_H
@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#include "log.hpp"
+
+void log_record::push(std::string_view v) {
+  auto size = std::min<size_t>(v.size(), TEXT_SIZE - text_used);
+  std::copy_n(v.begin(), size, text.begin() + text_used);
+  args[nargs].kind = arg::TEXT;
+  args[nargs].text = {text_used, static_cast<uint16_t>(size)};
+  ++nargs;
+  text_used += size;
+}
+
+void log_record::format(std::string &out) const {
+  unsigned next_arg = 0;
+  for (const char *p = fmt; *p; ++p) {
+    if (*p == '}' && p[1] == '}') {
+      out += *++p;
+      continue;
+    }
+    if (*p != '{') {
+      out += *p;
+      continue;
+    }
+    if (p[1] == '{') {
+      out += *++p;
+      continue;
+    }
+
+    // Parse {[:][0][width][x]}
+    bool zero_pad = false, hex = false;
+    unsigned width = 0;
+    const char *q = p + 1;
+    if (*q == ':') {
+      ++q;
+    }
+    if (*q == '0') {
+      zero_pad = true;
+      ++q;
+    }
+    for (; *q >= '0' && *q <= '9'; ++q) {
+      width = width * 10 + (*q - '0');
+    }
+    if (*q == 'x') {
+      hex = true;
+      ++q;
+    }
+    if (*q != '}') {
+      // Not a placeholder we understand; emit verbatim.
+      out += *p;
+      continue;
+    }
+    p = q;
+
+    if (next_arg >= nargs) {
+      out += "{?}";
+      continue;
+    }
+    const arg &a = args[next_arg++];
+    char buf[32];
+    int len = 0;
+    switch (a.kind) {
+    case arg::SIGNED:
+      len = std::snprintf(buf, sizeof(buf), hex ? "%llx" : "%lld",
+                          static_cast<long long>(a.i));
+      break;
+    case arg::UNSIGNED:
+      len = std::snprintf(buf, sizeof(buf), hex ? "%llx" : "%llu",
+                          static_cast<unsigned long long>(a.u));
+      break;
+    case arg::FLOATING:
+      len = std::snprintf(buf, sizeof(buf), "%g", a.d);
+      break;
+    case arg::TEXT:
+      out.append(text.data() + a.text.offset, a.text.size);
+      continue;
+    }
+    len = std::clamp(len, 0, static_cast<int>(sizeof(buf) - 1));
+    if (static_cast<unsigned>(len) < width) {
+      out.append(width - len, zero_pad ? '0' : ' ');
+    }
+    out.append(buf, len);
+  }
+}
+
+/*
+ * Bounded multi-producer queue after Dmitry Vyukov's MPMC design. Every cell
+ * carries a sequence number telling producers and the consumer whose turn it
+ * is, so neither side ever takes a lock.
+ */
+struct logger::impl {
+  const static unsigned CAPACITY = 1024; // Must be a power of two.
+
+  struct cell {
+    std::atomic<size_t> sequence;
+    log_record record;
+  };
+
+  std::unique_ptr<cell[]> cells;
+  alignas(64) std::atomic<size_t> enqueue_pos{0};
+  alignas(64) size_t dequeue_pos{0};
+  std::atomic<uint64_t> dropped{0};
+  std::atomic<uint64_t> written{0};
+  std::atomic<uint64_t> submitted{0};
+  std::atomic<std::ostream *> sink{&std::cerr};
+  std::atomic<bool> stop{false};
+  const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  std::thread thread;
+
+  impl() : cells(new cell[CAPACITY]) {
+    for (size_t i = 0; i < CAPACITY; ++i) {
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    thread = std::thread([this] { run(); });
+  }
+
+  bool try_push(const log_record &rec) {
+    size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+      cell &c = cells[pos & (CAPACITY - 1)];
+      size_t seq = c.sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                              std::memory_order_relaxed)) {
+          c.record = rec;
+          c.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false; // Full.
+      } else {
+        pos = enqueue_pos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool try_pop(log_record &rec) {
+    cell &c = cells[dequeue_pos & (CAPACITY - 1)];
+    size_t seq = c.sequence.load(std::memory_order_acquire);
+    if (seq != dequeue_pos + 1) {
+      return false; // Empty.
+    }
+    rec = c.record;
+    c.sequence.store(dequeue_pos + CAPACITY, std::memory_order_release);
+    ++dequeue_pos;
+    return true;
+  }
+
+  void run() {
+    static const char *const level_names[] = {"E", "W", "I", "D", "T"};
+    std::string out;
+    log_record rec;
+
+    for (;;) {
+      bool stopping = stop.load(std::memory_order_acquire);
+      uint64_t count = 0;
+      out.clear();
+      while (try_pop(rec)) {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                      rec.time - start)
+                      .count();
+        char prefix[48];
+        std::snprintf(prefix, sizeof(prefix), "[%6lld.%06lld] %s: ",
+                      static_cast<long long>(us / 1000000),
+                      static_cast<long long>(us % 1000000),
+                      level_names[static_cast<unsigned>(rec.level)]);
+        out += prefix;
+        rec.format(out);
+        out += '\n';
+        ++count;
+      }
+
+      if (count) {
+        std::ostream *os = sink.load(std::memory_order_acquire);
+        os->write(out.data(), out.size());
+        os->flush();
+        written.fetch_add(count, std::memory_order_release);
+      } else if (stopping) {
+        return;
+      } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+  }
+};
+
+logger &logger::instance() {
+  static logger instance;
+  return instance;
+}
+
+logger::logger() : m_impl(new impl), m_level(log_level::info) {}
+
+logger::~logger() {
+  m_impl->stop.store(true, std::memory_order_release);
+  m_impl->thread.join();
+  delete m_impl;
+}
+
+void logger::set_sink(std::ostream &os) {
+  flush();
+  m_impl->sink.store(&os, std::memory_order_release);
+}
+
+void logger::submit(const log_record &rec) {
+  if (m_impl->try_push(rec)) {
+    m_impl->submitted.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    m_impl->dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void logger::flush() {
+  uint64_t target = m_impl->submitted.load(std::memory_order_relaxed);
+  while (m_impl->written.load(std::memory_order_acquire) < target) {
+    std::this_thread::yield();
+  }
+}
+
+uint64_t logger::dropped() const {
+  return m_impl->dropped.load(std::memory_order_relaxed);
+}
+
+bool parse_log_level(std::string_view name, log_level &level) {
+  static const std::pair<std::string_view, log_level> names[] = {
+      {"error", log_level::error}, {"warn", log_level::warn},
+      {"info", log_level::info},   {"debug", log_level::debug},
+      {"trace", log_level::trace},
+  };
+  for (auto [n, l] : names) {
+    if (n == name) {
+      level = l;
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,157 @@
+#ifndef SWIMP_LOG_H
+#define SWIMP_LOG_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+enum class log_level : uint8_t {
+  error = 0,
+  warn = 1,
+  info = 2,
+  debug = 3,
+  trace = 4,
+};
+
+/*
+ * Records above this level are compiled out entirely. Building with
+ * -DSWIMP_LOG_MAX_LEVEL=4 enables per-instruction tracing.
+ */
+#ifndef SWIMP_LOG_MAX_LEVEL
+#define SWIMP_LOG_MAX_LEVEL 3
+#endif
+
+/// A single pending log record. Formatting happens on the sink thread.
+struct log_record {
+  const static unsigned MAX_ARGS = 8;
+  const static unsigned TEXT_SIZE = 128;
+
+  struct arg {
+    enum kind : uint8_t { SIGNED, UNSIGNED, FLOATING, TEXT } kind;
+    union {
+      int64_t i;
+      uint64_t u;
+      double d;
+      struct {
+        uint16_t offset;
+        uint16_t size;
+      } text;
+    };
+  };
+
+  std::chrono::steady_clock::time_point time;
+  /// Must point to a string literal; it is read after the caller returns.
+  const char *fmt;
+  log_level level;
+  uint8_t nargs;
+  uint16_t text_used;
+  std::array<arg, MAX_ARGS> args;
+  /// Backing storage for string arguments, which are copied (and truncated).
+  std::array<char, TEXT_SIZE> text;
+
+  inline void push(std::signed_integral auto v) {
+    args[nargs].kind = arg::SIGNED;
+    args[nargs++].i = v;
+  }
+  inline void push(std::unsigned_integral auto v) {
+    args[nargs].kind = arg::UNSIGNED;
+    args[nargs++].u = v;
+  }
+  inline void push(std::floating_point auto v) {
+    args[nargs].kind = arg::FLOATING;
+    args[nargs++].d = v;
+  }
+  void push(std::string_view v);
+  inline void push(const char *v) { push(std::string_view(v)); }
+  inline void push(const std::string &v) { push(std::string_view(v)); }
+
+  /// Appends the formatted message (without level or timestamp) to out.
+  void format(std::string &out) const;
+};
+
+/**
+ * Process-wide logger.
+ *
+ * Records are queued on a bounded lock-free queue and formatted and written by
+ * a background thread, so logging never blocks the caller on terminal or file
+ * I/O. If the queue is full the record is dropped and counted instead.
+ *
+ * Format strings use `{}` placeholders, optionally with a zero-padded width
+ * and `x` for hex, e.g. `{:04x}`.
+ */
+class logger {
+public:
+  static logger &instance();
+
+  inline bool enabled(log_level level) const {
+    return level <= m_level.load(std::memory_order_relaxed);
+  }
+
+  inline void set_level(log_level level) {
+    m_level.store(level, std::memory_order_relaxed);
+  }
+
+  /// Redirect output. The stream must outlive the logger.
+  void set_sink(std::ostream &os);
+
+  template <class... Args>
+  void write(log_level level, const char *fmt, const Args &...args) {
+    static_assert(sizeof...(Args) <= log_record::MAX_ARGS);
+    log_record rec;
+    rec.time = std::chrono::steady_clock::now();
+    rec.fmt = fmt;
+    rec.level = level;
+    rec.nargs = 0;
+    rec.text_used = 0;
+    (rec.push(args), ...);
+    submit(rec);
+  }
+
+  /// Blocks until all records queued so far have been written.
+  void flush();
+
+  /// Number of records dropped because the queue was full.
+  uint64_t dropped() const;
+
+  ~logger();
+
+private:
+  logger();
+  logger(const logger &) = delete;
+  logger &operator=(const logger &) = delete;
+
+  void submit(const log_record &rec);
+
+  struct impl;
+  impl *m_impl;
+  std::atomic<log_level> m_level;
+};
+
+/// Parses "error", "warn", "info", "debug" or "trace".
+bool parse_log_level(std::string_view name, log_level &level);
+
+#define SWIMP_LOG_ENABLED(level)                                               \
+  (static_cast<int>(level) <= SWIMP_LOG_MAX_LEVEL &&                           \
+   logger::instance().enabled(level))
+
+#define SWIMP_LOG(level, ...)                                                  \
+  do {                                                                         \
+    if constexpr (static_cast<int>(level) <= SWIMP_LOG_MAX_LEVEL) {            \
+      if (logger::instance().enabled(level)) {                                 \
+        logger::instance().write(level, __VA_ARGS__);                          \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
+
+#define LOG_ERROR(...) SWIMP_LOG(log_level::error, __VA_ARGS__)
+#define LOG_WARN(...) SWIMP_LOG(log_level::warn, __VA_ARGS__)
+#define LOG_INFO(...) SWIMP_LOG(log_level::info, __VA_ARGS__)
+#define LOG_DEBUG(...) SWIMP_LOG(log_level::debug, __VA_ARGS__)
+#define LOG_TRACE(...) SWIMP_LOG(log_level::trace, __VA_ARGS__)
+
+#endif // SWIMP_LOG_H
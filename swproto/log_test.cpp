@@ -0,0 +1,114 @@
+#include <cstdlib>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "log.hpp"
+
+/// Formats a record the way the sink thread would, minus the prefix.
+template <class... Args>
+static std::string format(const char *fmt, const Args &...args) {
+  log_record rec;
+  rec.fmt = fmt;
+  rec.nargs = 0;
+  rec.text_used = 0;
+  (rec.push(args), ...);
+  std::string out;
+  rec.format(out);
+  return out;
+}
+
+TEST(LogTest, TestFormatSpecs) {
+  ASSERT_EQ(format("{} and {}", 42, -7), "42 and -7");
+  ASSERT_EQ(format("{}", uint64_t{18446744073709551615u}),
+            "18446744073709551615");
+  ASSERT_EQ(format("{:04x}", 0xABu), "00ab");
+  ASSERT_EQ(format("{:x}", int8_t{-1}), "ffffffffffffffff");
+  ASSERT_EQ(format("[{:5}]", 42), "[   42]");
+  ASSERT_EQ(format("[{:03}]", 1234), "[1234]") << "width is a minimum";
+  ASSERT_EQ(format("{}", 1.5), "1.5");
+  ASSERT_EQ(format("{} {}", "text", std::string("more")), "text more");
+  ASSERT_EQ(format("{{}} {}", 1), "{} 1");
+  ASSERT_EQ(format("{} {}", 1), "1 {?}");
+  ASSERT_EQ(format("{:y} {}", 1), "{:y} 1") << "unknown specs are verbatim";
+
+  // String arguments share a fixed buffer and are truncated to fit it.
+  std::string longer(log_record::TEXT_SIZE + 10, 'a');
+  ASSERT_EQ(format("{}|{}", longer, "b"),
+            std::string(log_record::TEXT_SIZE, 'a') + "|");
+}
+
+TEST(LogTest, TestLevelFiltering) {
+  std::stringstream sink;
+  logger &log = logger::instance();
+  log.set_sink(sink);
+  log.set_level(log_level::warn);
+
+  ASSERT_TRUE(SWIMP_LOG_ENABLED(log_level::warn));
+  ASSERT_FALSE(SWIMP_LOG_ENABLED(log_level::info));
+  LOG_INFO("hidden {}", 1);
+  LOG_WARN("shown {}", 2);
+  LOG_ERROR("shown {}", 3);
+
+  // Trace is compiled out unless SWIMP_LOG_MAX_LEVEL allows it.
+  log.set_level(log_level::trace);
+  ASSERT_EQ(SWIMP_LOG_ENABLED(log_level::trace), SWIMP_LOG_MAX_LEVEL >= 4);
+  ASSERT_TRUE(SWIMP_LOG_ENABLED(log_level::debug));
+  LOG_DEBUG("shown {}", 4);
+
+  log.flush();
+  log.set_sink(std::cerr);
+  log.set_level(log_level::info);
+
+  std::vector<std::string> lines;
+  for (std::string line; std::getline(sink, line);) {
+    lines.push_back(line.substr(line.find(']') + 2));
+  }
+  ASSERT_EQ(lines, (std::vector<std::string>{"W: shown 2", "E: shown 3",
+                                             "D: shown 4"}));
+}
+
+TEST(LogTest, TestDestructorDrainsEveryThread) {
+  const unsigned threads = 4, per_thread = 200;
+  static_assert(threads * per_thread < 1024, "nothing may be dropped");
+  std::string path = testing::TempDir() + "log_test_drain.txt";
+
+  // The logger only goes away at exit, so exit in a fresh process.
+  GTEST_FLAG_SET(death_test_style, "threadsafe");
+  EXPECT_EXIT(
+      {
+        // Constructed before the logger, so destroyed after it.
+        static std::ofstream sink(path);
+        logger::instance().set_sink(sink);
+        std::vector<std::thread> writers;
+        for (unsigned t = 0; t < threads; ++t) {
+          writers.emplace_back([t] {
+            for (unsigned i = 0; i < per_thread; ++i) {
+              LOG_INFO("{} {}", t, i);
+            }
+          });
+        }
+        for (auto &writer : writers) {
+          writer.join();
+        }
+        std::exit(0);
+      },
+      testing::ExitedWithCode(0), "");
+
+  // Every message arrives, and each thread's in the order it sent them.
+  std::ifstream in(path);
+  std::vector<unsigned> next(threads, 0);
+  unsigned lines = 0;
+  for (std::string line; std::getline(in, line); ++lines) {
+    std::istringstream fields(line.substr(line.find("I: ") + 3));
+    unsigned t, i;
+    ASSERT_TRUE(fields >> t >> i) << line;
+    ASSERT_LT(t, threads);
+    ASSERT_EQ(i, next[t]++);
+  }
+  ASSERT_EQ(lines, threads * per_thread);
+  std::remove(path.c_str());
+}
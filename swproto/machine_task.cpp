@@ -0,0 +1,67 @@
+#include "machine_task.hpp"
+
+void machine_task::promise_type::awaiter::await_suspend(
+    std::coroutine_handle<promise_type>) const {
+  promise.scheduler->park(promise.id, on_key);
+}
+
+machine_scheduler::task_id machine_scheduler::spawn(machine_task task) {
+  task_id id = m_tasks.size();
+  auto &promise = task.m_handle.promise();
+  promise.scheduler = this;
+  promise.id = id;
+  m_tasks.push_back({.task = std::move(task),
+                     .state = task_state::RUNNABLE,
+                     .keystate = 0,
+                     .parked_frame = m_frame});
+  m_runnable.push_back(id);
+  return id;
+}
+
+void machine_scheduler::set_keys(task_id id, uint16_t keystate) {
+  slot &task = m_tasks.at(id);
+  task.keystate = keystate;
+  if (task.state == task_state::WAITING_FOR_KEY && keystate) {
+    task.state = task_state::RUNNABLE;
+    --m_waiting_for_key;
+    m_runnable.push_back(id);
+  }
+}
+
+void machine_scheduler::park(task_id id, bool on_key) {
+  slot &task = m_tasks[id];
+  task.parked_frame = m_frame;
+  if (on_key && !task.keystate) {
+    task.state = task_state::WAITING_FOR_KEY;
+    ++m_waiting_for_key;
+  } else {
+    m_runnable.push_back(id);
+  }
+}
+
+size_t machine_scheduler::run_frame() {
+  ++m_frame;
+  // Tasks that park while running queue themselves for the next frame.
+  m_running.swap(m_runnable);
+  m_runnable.clear();
+  for (task_id id : m_running) {
+    slot &task = m_tasks[id];
+    auto handle = task.task.m_handle;
+    handle.promise().input = {.keystate = task.keystate,
+                              .frames = m_frame - task.parked_frame};
+    handle.resume();
+    if (handle.done()) {
+      task.state = task_state::DONE;
+    }
+  }
+  return m_running.size();
+}
+
+std::optional<statemachine_common::status>
+machine_scheduler::result(task_id id) const {
+  const slot &task = m_tasks.at(id);
+  if (task.state != task_state::DONE) {
+    return std::nullopt;
+  }
+  return task.task.m_handle.promise().result;
+}
@@ -0,0 +1,167 @@
+#ifndef SWIMP_MACHINE_TASK_H
+#define SWIMP_MACHINE_TASK_H
+
+#include <coroutine>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "statemachine.hpp"
+
+class machine_scheduler;
+
+/// What a run task sees when it's resumed.
+struct frame_input {
+  uint16_t keystate;
+  /// Frame boundaries that passed while the task was suspended.
+  uint64_t frames;
+};
+
+/// Awaited by a run task to give up the rest of the current frame.
+struct next_frame {};
+
+/// Awaited by a run task that is blocked on Fx0A. The scheduler resumes it at
+/// the first frame boundary at which a key is held.
+struct key_press {};
+
+/**
+ * Coroutine type of a machine's run loop; see run_machine(). Tasks start
+ * suspended and are resumed only by the machine_scheduler that owns them.
+ */
+class machine_task {
+public:
+  struct promise_type {
+    machine_scheduler *scheduler = nullptr;
+    size_t id = 0;
+    frame_input input{.keystate = 0, .frames = 1};
+    /// Set until the task consumes the input it was first resumed with.
+    bool fresh_input = true;
+    statemachine_common::status result = statemachine_common::NO_ERROR;
+
+    machine_task get_return_object() {
+      return machine_task(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_value(statemachine_common::status status) { result = status; }
+    void unhandled_exception() { throw; }
+
+    struct awaiter {
+      promise_type &promise;
+      bool on_key;
+
+      bool await_ready() const noexcept { return promise.fresh_input; }
+      void await_suspend(std::coroutine_handle<promise_type>) const;
+      frame_input await_resume() const noexcept {
+        promise.fresh_input = false;
+        return promise.input;
+      }
+    };
+
+    awaiter await_transform(next_frame) { return {*this, false}; }
+    awaiter await_transform(key_press) { return {*this, true}; }
+  };
+
+  machine_task(machine_task &&other)
+      : m_handle(std::exchange(other.m_handle, {})) {}
+  machine_task(const machine_task &) = delete;
+  ~machine_task() {
+    if (m_handle) {
+      m_handle.destroy();
+    }
+  }
+
+private:
+  friend class machine_scheduler;
+
+  explicit machine_task(std::coroutine_handle<promise_type> handle)
+      : m_handle(handle) {}
+
+  std::coroutine_handle<promise_type> m_handle;
+};
+
+/**
+ * Runs `mach` for `cycles_per_frame` cycles per frame until it reports an
+ * error, which becomes the task's result.
+ *
+ * Instead of spinning on Fx0A the task parks until a key is held. The frames
+ * it spends parked are credited to the machine as idle cycles so the timers
+ * run down exactly as if it had been stepped the whole time.
+ */
+template <class Machine>
+machine_task run_machine(Machine &mach, uint32_t cycles_per_frame) {
+  uint64_t frame_end = mach.cycles();
+  frame_input input = co_await next_frame{};
+  for (;;) {
+    frame_end += input.frames * cycles_per_frame;
+    mach.idle_until(frame_end - cycles_per_frame);
+
+    auto status = statemachine_common::NO_ERROR;
+    while (status != statemachine_common::WAITING_FOR_KEYPRESS &&
+           mach.cycles() < frame_end) {
+      status = mach.step(input.keystate);
+      if (status < 0) {
+        co_return status;
+      }
+    }
+
+    if (status == statemachine_common::WAITING_FOR_KEYPRESS) {
+      input = co_await key_press{};
+    } else {
+      input = co_await next_frame{};
+    }
+  }
+}
+
+/**
+ * Single-threaded frame scheduler for many machines. Each run_frame() resumes
+ * only the tasks that are runnable this frame: those that awaited
+ * next_frame, and those blocked on Fx0A whose keys are now held. A task
+ * waiting for a key costs nothing until its keys change.
+ */
+class machine_scheduler {
+public:
+  using task_id = size_t;
+
+  /// Takes ownership of `task`, which first runs at the next run_frame().
+  task_id spawn(machine_task task);
+
+  /// Sets the keys the task sees from its next resumption on.
+  void set_keys(task_id id, uint16_t keystate);
+
+  /// Resumes every runnable task once. Returns how many were resumed.
+  size_t run_frame();
+
+  /// Status the task finished with, or nullopt while it's still running.
+  std::optional<statemachine_common::status> result(task_id id) const;
+
+  /// Number of tasks parked on Fx0A.
+  inline size_t waiting_for_key() const { return m_waiting_for_key; };
+
+  inline uint64_t frame() const { return m_frame; };
+
+private:
+  friend struct machine_task::promise_type::awaiter;
+
+  enum class task_state { RUNNABLE, WAITING_FOR_KEY, DONE };
+
+  struct slot {
+    machine_task task;
+    task_state state;
+    uint16_t keystate;
+    /// Frame during which the task last suspended.
+    uint64_t parked_frame;
+  };
+
+  void park(task_id id, bool on_key);
+
+  std::vector<slot> m_tasks;
+  std::vector<task_id> m_runnable;
+  std::vector<task_id> m_running;
+  size_t m_waiting_for_key = 0;
+  uint64_t m_frame = 0;
+};
+
+#endif // SWIMP_MACHINE_TASK_H
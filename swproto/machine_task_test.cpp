@@ -0,0 +1,52 @@
+#include <gtest/gtest.h>
+#include <initializer_list>
+
+#include "machine_task.hpp"
+
+TEST(MachineTaskTest, TestRunsFrames) {
+  statemachine machine({
+      0x7001, // ADD V0, 1
+      0x1000, // JP 0x000
+  });
+  machine_scheduler scheduler;
+  auto id = scheduler.spawn(run_machine(machine, 10));
+
+  ASSERT_EQ(scheduler.run_frame(), 1);
+  ASSERT_EQ(machine.cycles(), 10);
+  ASSERT_EQ(scheduler.run_frame(), 1);
+  ASSERT_EQ(machine.cycles(), 20);
+  ASSERT_EQ(machine.regs()[0], 10);
+  ASSERT_FALSE(scheduler.result(id).has_value());
+}
+
+TEST(MachineTaskTest, TestParksOnKeyWait) {
+  statemachine machine(
+      {
+          0x6005, // LD V0, 5
+          0xF015, // LD DT, V0
+          0xF10A, // LD V1, K
+          0xF207, // LD V2, DT
+          0x00EE, // RET (fails)
+      },
+      {.cycles_per_tick = 10});
+  machine_scheduler scheduler;
+  auto id = scheduler.spawn(run_machine(machine, 10));
+
+  ASSERT_EQ(scheduler.run_frame(), 1);
+  ASSERT_EQ(machine.pc(), 0x004);
+  ASSERT_EQ(scheduler.waiting_for_key(), 1);
+
+  // Parked tasks aren't resumed at all.
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_EQ(scheduler.run_frame(), 0);
+  }
+  ASSERT_EQ(machine.cycles(), 3);
+
+  scheduler.set_keys(id, 1u << 7u);
+  ASSERT_EQ(scheduler.waiting_for_key(), 0);
+  ASSERT_EQ(scheduler.run_frame(), 1);
+  // The four frames spent waiting count towards the timers.
+  ASSERT_EQ(machine.regs()[1], 7);
+  ASSERT_EQ(machine.regs()[2], 1);
+  ASSERT_EQ(scheduler.result(id), statemachine::POPPED_EMPTY_STACK);
+}
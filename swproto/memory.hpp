@@ -0,0 +1,151 @@
+#ifndef SWIMP_MEMORY_H
+#define SWIMP_MEMORY_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ranges>
+#include <span>
+#include <utility>
+
+/// Initial memory contents of a machine.
+template <unsigned Size> using rom_image = std::array<uint8_t, Size>;
+
+/*
+ * Memory policies for basic_statemachine. Every policy provides read(),
+ * write() and view(); callers are responsible for masking addresses to Size.
+ */
+
+/// Memory held inline in the machine.
+template <unsigned Size> class flat_memory {
+public:
+  constexpr flat_memory(const rom_image<Size> &contents)
+      : m_bytes(contents) {}
+
+  constexpr uint8_t read(uint16_t addr) const { return m_bytes[addr]; }
+
+  constexpr void write(uint16_t addr, uint8_t value) { m_bytes[addr] = value; }
+
+  constexpr std::span<const uint8_t, Size> view() const { return m_bytes; }
+
+private:
+  rom_image<Size> m_bytes;
+};
+
+/**
+ * Memory backed by a shared read-only ROM image with a private copy-on-write
+ * overlay.
+ *
+ * A page is copied into the overlay the first time it is written. Copying a
+ * machine shares both the ROM image and its private pages, so clones cost a
+ * page table each; whichever copy writes to a shared page first gets its own.
+ */
+template <unsigned Size> class cow_memory {
+public:
+  const static unsigned PAGE_SIZE = 256;
+  const static unsigned PAGES = Size / PAGE_SIZE;
+
+  cow_memory(std::shared_ptr<const rom_image<Size>> rom)
+      : m_rom(std::move(rom)) {
+    for (unsigned p = 0; p < PAGES; ++p) {
+      m_pages[p] = m_rom->data() + p * PAGE_SIZE;
+    }
+  }
+
+  cow_memory(const rom_image<Size> &contents)
+      : cow_memory(std::make_shared<const rom_image<Size>>(contents)) {}
+
+  inline uint8_t read(uint16_t addr) const {
+    return m_pages[addr / PAGE_SIZE][addr % PAGE_SIZE];
+  }
+
+  inline void write(uint16_t addr, uint8_t value) {
+    auto &page = m_private[addr / PAGE_SIZE];
+    if (!page || !page.unique()) [[unlikely]] {
+      materialize(addr / PAGE_SIZE);
+    }
+    page.data()[addr % PAGE_SIZE] = value;
+  }
+
+  inline auto view() const {
+    return std::views::iota(0u, Size) |
+           std::views::transform([pages = m_pages.data()](unsigned addr) {
+             return pages[addr / PAGE_SIZE][addr % PAGE_SIZE];
+           });
+  }
+
+  /// Number of pages this machine has a private (possibly shared) copy of.
+  unsigned private_pages() const {
+    return std::count_if(m_private.begin(), m_private.end(),
+                         [](const auto &page) { return !!page; });
+  }
+
+private:
+  /**
+   * Reference-counted private page. Copies of a machine may be dropped on
+   * other threads, so unique() is an acquire load that synchronizes with
+   * their releases: once it's true, every read they made of the page
+   * happened before our writes. shared_ptr::use_count() is relaxed and can't
+   * promise that.
+   */
+  class page_ref {
+  public:
+    page_ref() = default;
+
+    explicit page_ref(const uint8_t *contents) : m_page(new page) {
+      std::copy_n(contents, PAGE_SIZE, m_page->bytes.begin());
+    }
+
+    page_ref(const page_ref &other) : m_page(other.m_page) {
+      if (m_page) {
+        m_page->owners.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    page_ref(page_ref &&other) noexcept
+        : m_page(std::exchange(other.m_page, nullptr)) {}
+
+    page_ref &operator=(page_ref other) noexcept {
+      std::swap(m_page, other.m_page);
+      return *this;
+    }
+
+    ~page_ref() {
+      if (m_page &&
+          m_page->owners.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete m_page;
+      }
+    }
+
+    explicit operator bool() const { return m_page != nullptr; }
+
+    bool unique() const {
+      return m_page->owners.load(std::memory_order_acquire) == 1;
+    }
+
+    uint8_t *data() const { return m_page->bytes.data(); }
+
+  private:
+    struct page {
+      std::array<uint8_t, PAGE_SIZE> bytes;
+      std::atomic<uint32_t> owners{1};
+    };
+
+    page *m_page = nullptr;
+  };
+
+  void materialize(unsigned p) {
+    page_ref copy(m_pages[p]);
+    m_pages[p] = copy.data();
+    m_private[p] = std::move(copy);
+  }
+
+  /// Where each page is currently read from.
+  std::array<const uint8_t *, PAGES> m_pages;
+  std::array<page_ref, PAGES> m_private;
+  std::shared_ptr<const rom_image<Size>> m_rom;
+};
+
+#endif // SWIMP_MEMORY_H
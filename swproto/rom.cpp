@@ -0,0 +1,20 @@
+#include <fstream>
+#include <vector>
+
+#include "rom.hpp"
+
+std::optional<rom_image<statemachine::MEMORY_SIZE>>
+try_load(const std::string &path) {
+  using namespace std;
+  ifstream fs(path, std::fstream::in | std::fstream::binary);
+  if (!fs.is_open()) {
+    return nullopt;
+  }
+
+  // Read one byte more than fits so that oversized files are rejected.
+  vector<uint8_t> program(statemachine::MEMORY_SIZE - statemachine::PROG_BEGIN +
+                          1);
+  fs.read(reinterpret_cast<char *>(program.data()), program.size());
+  program.resize(fs.gcount());
+  return load_rom(program);
+}
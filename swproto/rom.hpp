@@ -0,0 +1,31 @@
+#ifndef SWIMP_ROM_H
+#define SWIMP_ROM_H
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+
+#include "font.hpp"
+#include "memory.hpp"
+#include "statemachine.hpp"
+
+/// Places a program at PROG_BEGIN and fonts starting at 0x000.
+constexpr std::optional<rom_image<statemachine::MEMORY_SIZE>>
+load_rom(std::span<const uint8_t> program) {
+  if (program.size() > statemachine::MEMORY_SIZE - statemachine::PROG_BEGIN) {
+    return std::nullopt;
+  }
+  rom_image<statemachine::MEMORY_SIZE> ret{};
+  std::copy(font.begin(), font.end(), ret.begin());
+  std::copy(program.begin(), program.end(),
+            ret.begin() + statemachine::PROG_BEGIN);
+  return ret;
+}
+
+/// Reads file contents into CHIP8 memory and places fonts starting at 0x000.
+std::optional<rom_image<statemachine::MEMORY_SIZE>>
+try_load(const std::string &path);
+
+#endif // SWIMP_ROM_H
@@ -0,0 +1,347 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include "log.hpp"
+#include "rom.hpp"
+#include "rom_library.hpp"
+#include "sweep.hpp"
+
+static const size_t IMAGE_ALIGNMENT = 4096;
+
+void rom_profile::apply(statemachine::init_conf &conf) const {
+  for (size_t i = 0; i < std::size(QUIRKS); ++i) {
+    QUIRKS[i].set(conf, quirks & (1u << i));
+  }
+  if (cycles_per_frame) {
+    conf.cycles_per_tick = cycles_per_frame;
+  }
+}
+
+uint16_t rom_profile::map_keys(uint16_t keystate) const {
+  uint16_t ret = 0;
+  for (unsigned i = 0; i < keys.size(); ++i) {
+    if ((keystate >> i) & 1) {
+      ret |= 1u << (keys[i] & 0xF);
+    }
+  }
+  return ret;
+}
+
+uint64_t rom_hash(std::span<const uint8_t> program) {
+  uint64_t hash = 0xCBF29CE484222325;
+  for (uint8_t byte : program) {
+    hash = (hash ^ byte) * 0x100000001B3;
+  }
+  return hash;
+}
+
+rom_profile rom_profile::defaults() {
+  rom_profile ret{};
+  for (unsigned i = 0; i < ret.keys.size(); ++i) {
+    ret.keys[i] = i;
+  }
+  return ret;
+}
+
+namespace {
+
+/// Reads a profile; lines that don't parse are skipped with a warning.
+rom_profile read_profile(const std::filesystem::path &path) {
+  rom_profile ret = rom_profile::defaults();
+  std::ifstream in(path);
+  for (std::string line; std::getline(in, line);) {
+    std::istringstream fields(line);
+    std::string key;
+    if (!(fields >> key) || key.starts_with('#')) {
+      continue;
+    }
+    bool ok = true;
+    if (key == "quirks") {
+      for (std::string name; fields >> name;) {
+        auto it = std::find_if(
+            std::begin(QUIRKS), std::end(QUIRKS),
+            [&](const quirk &q) { return name == q.name; });
+        ok &= it != std::end(QUIRKS) || name == "none";
+        if (it != std::end(QUIRKS)) {
+          ret.quirks |= 1u << (it - std::begin(QUIRKS));
+        }
+      }
+    } else if (key == "cycles_per_frame") {
+      ok = static_cast<bool>(fields >> ret.cycles_per_frame);
+    } else if (key == "keys") {
+      std::string digits;
+      ok = (fields >> digits) && digits.size() == ret.keys.size() &&
+           digits.find_first_not_of("0123456789abcdefABCDEF") ==
+               std::string::npos;
+      for (unsigned i = 0; ok && i < digits.size(); ++i) {
+        ret.keys[i] = std::stoul(digits.substr(i, 1), nullptr, 16);
+      }
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      LOG_WARN("{}: ignoring \"{}\"", path.string(), line);
+    }
+  }
+  return ret;
+}
+
+struct indexed_rom {
+  std::string name;
+  std::vector<uint8_t> program;
+  rom_profile profile;
+};
+
+std::vector<indexed_rom> scan(const std::filesystem::path &directory) {
+  namespace fs = std::filesystem;
+  std::vector<indexed_rom> ret;
+  std::error_code ec;
+  fs::recursive_directory_iterator it(
+      directory, fs::directory_options::skip_permission_denied, ec);
+  for (; !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+    const fs::path &path = it->path();
+    if (!it->is_regular_file() || path.extension() != ".ch8") {
+      continue;
+    }
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> program(
+        (std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (!in.good() && !in.eof()) {
+      LOG_WARN("Failed to read {}", path.string());
+      continue;
+    }
+    if (program.size() >
+        statemachine::MEMORY_SIZE - statemachine::PROG_BEGIN) {
+      LOG_WARN("{} is too large to load", path.string());
+      continue;
+    }
+    fs::path profile_path = fs::path(path).replace_extension(".profile");
+    ret.push_back({.name = path.lexically_relative(directory).string(),
+                   .program = std::move(program),
+                   .profile = fs::exists(profile_path)
+                                  ? read_profile(profile_path)
+                                  : rom_profile::defaults()});
+  }
+  if (ec) {
+    LOG_WARN("Stopped scanning {}: {}", directory.string(), ec.message());
+  }
+  return ret;
+}
+
+size_t align(size_t offset, size_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+bool build_rom_index(const std::string &directory,
+                     const std::string &index_path) {
+  std::vector<indexed_rom> roms = scan(directory);
+  std::sort(roms.begin(), roms.end(),
+            [](const auto &a, const auto &b) { return a.name < b.name; });
+
+  std::vector<rom_index_entry> entries;
+  std::string names;
+  // Identical programs share an image; the hash only narrows the search.
+  std::vector<size_t> image_roms;
+  std::unordered_multimap<uint64_t, uint32_t> images_by_hash;
+  for (size_t i = 0; i < roms.size(); ++i) {
+    const indexed_rom &rom = roms[i];
+    uint64_t hash = rom_hash(rom.program);
+    std::optional<uint32_t> image;
+    auto [begin, end] = images_by_hash.equal_range(hash);
+    for (auto it = begin; it != end && !image; ++it) {
+      if (roms[image_roms[it->second]].program == rom.program) {
+        image = it->second;
+      }
+    }
+    if (!image) {
+      image = image_roms.size();
+      image_roms.push_back(i);
+      images_by_hash.emplace(hash, *image);
+    }
+    entries.push_back({.hash = hash,
+                       .name_offset = static_cast<uint32_t>(names.size()),
+                       .name_size = static_cast<uint16_t>(rom.name.size()),
+                       .program_size =
+                           static_cast<uint16_t>(rom.program.size()),
+                       .image = *image,
+                       .profile = rom.profile});
+    names += rom.name;
+  }
+
+  std::vector<uint32_t> by_hash(entries.size());
+  for (uint32_t i = 0; i < by_hash.size(); ++i) {
+    by_hash[i] = i;
+  }
+  std::sort(by_hash.begin(), by_hash.end(), [&](uint32_t a, uint32_t b) {
+    return entries[a].hash < entries[b].hash;
+  });
+
+  rom_index_header header{
+      .magic = ROM_INDEX_MAGIC,
+      .version = ROM_INDEX_VERSION,
+      .entries = static_cast<uint32_t>(entries.size()),
+      .images = static_cast<uint32_t>(image_roms.size()),
+  };
+  header.by_hash_offset =
+      sizeof(header) + entries.size() * sizeof(rom_index_entry);
+  header.names_offset = header.by_hash_offset + by_hash.size() * 4;
+  header.images_offset =
+      align(header.names_offset + names.size(), IMAGE_ALIGNMENT);
+  header.size =
+      header.images_offset + image_roms.size() * statemachine::MEMORY_SIZE;
+  // Like every other offset, name offsets are from the start of the file.
+  for (rom_index_entry &entry : entries) {
+    entry.name_offset += header.names_offset;
+  }
+
+  std::string tmp_path = index_path + ".tmp";
+  std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+  auto write = [&out](const void *data, size_t size) {
+    out.write(static_cast<const char *>(data), size);
+  };
+  write(&header, sizeof(header));
+  write(entries.data(), entries.size() * sizeof(rom_index_entry));
+  write(by_hash.data(), by_hash.size() * 4);
+  write(names.data(), names.size());
+  std::vector<char> padding(header.images_offset - header.names_offset -
+                            names.size());
+  write(padding.data(), padding.size());
+  for (size_t rom : image_roms) {
+    auto image = load_rom(roms[rom].program);
+    write(image->data(), image->size());
+  }
+  out.close();
+
+  std::error_code ec;
+  if (out) {
+    std::filesystem::rename(tmp_path, index_path, ec);
+  }
+  if (!out || ec) {
+    LOG_ERROR("Failed to write {}", index_path);
+    std::filesystem::remove(tmp_path, ec);
+    return false;
+  }
+  LOG_INFO("Indexed {} ROMs ({} distinct) from {}", entries.size(),
+           image_roms.size(), directory);
+  return true;
+}
+
+std::optional<rom_library> rom_library::open(const std::string &index_path) {
+  int fd = ::open(index_path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    LOG_ERROR("open({}) failed: {}", index_path, std::strerror(errno));
+    return std::nullopt;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      static_cast<size_t>(st.st_size) < sizeof(rom_index_header)) {
+    LOG_ERROR("{} is not a ROM index", index_path);
+    close(fd);
+    return std::nullopt;
+  }
+  size_t size = st.st_size;
+  void *base = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    LOG_ERROR("mmap({}) failed: {}", index_path, std::strerror(errno));
+    return std::nullopt;
+  }
+  rom_library ret(std::shared_ptr<const uint8_t>(
+      static_cast<const uint8_t *>(base),
+      [size](const uint8_t *p) { munmap(const_cast<uint8_t *>(p), size); }));
+
+  // Only the header and table bounds are checked here, so that opening
+  // doesn't touch every page; accessors check the rest as they go.
+  const rom_index_header &h = ret.header();
+  if (h.magic != ROM_INDEX_MAGIC || h.version != ROM_INDEX_VERSION ||
+      h.size != size ||
+      h.by_hash_offset !=
+          sizeof(h) + uint64_t{h.entries} * sizeof(rom_index_entry) ||
+      h.names_offset != h.by_hash_offset + uint64_t{h.entries} * 4 ||
+      h.images_offset < h.names_offset ||
+      h.images_offset % IMAGE_ALIGNMENT != 0 ||
+      h.images_offset + uint64_t{h.images} * statemachine::MEMORY_SIZE !=
+          size) {
+    LOG_ERROR("{} is not a valid ROM index", index_path);
+    return std::nullopt;
+  }
+  return ret;
+}
+
+std::string_view rom_library::name(size_t i) const {
+  const rom_index_entry &e = entry(i);
+  if (e.name_offset < header().names_offset ||
+      e.name_offset + e.name_size > header().images_offset) {
+    return {};
+  }
+  return {reinterpret_cast<const char *>(m_base.get() + e.name_offset),
+          e.name_size};
+}
+
+std::optional<size_t> rom_library::find(std::string_view name) const {
+  size_t lo = 0, hi = size();
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (this->name(mid) < name) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo < size() && this->name(lo) == name ? std::optional(lo)
+                                               : std::nullopt;
+}
+
+std::optional<size_t> rom_library::find(uint64_t hash) const {
+  const uint32_t *begin = by_hash();
+  const uint32_t *end = begin + size();
+  const uint32_t *it =
+      std::lower_bound(begin, end, hash, [this](uint32_t i, uint64_t hash) {
+        return i < size() && entry(i).hash < hash;
+      });
+  return it != end && *it < size() && entry(*it).hash == hash
+             ? std::optional<size_t>(*it)
+             : std::nullopt;
+}
+
+std::shared_ptr<const rom_image<statemachine::MEMORY_SIZE>>
+rom_library::image(size_t i) const {
+  uint32_t image = entry(i).image;
+  if (image >= header().images) {
+    return nullptr;
+  }
+  // Shares ownership of the whole mapping.
+  return std::shared_ptr<const rom_image<statemachine::MEMORY_SIZE>>(
+      m_base,
+      reinterpret_cast<const rom_image<statemachine::MEMORY_SIZE> *>(
+          m_base.get() + header().images_offset +
+          size_t{image} * statemachine::MEMORY_SIZE));
+}
+
+std::optional<library_rom> load_from_library(const std::string &index_path,
+                                             std::string_view name) {
+  auto library = rom_library::open(index_path);
+  if (!library) {
+    return std::nullopt;
+  }
+  auto found = library->find(name);
+  auto image = found ? library->image(*found) : nullptr;
+  if (!image) {
+    LOG_ERROR("{} is not in {}", name, index_path);
+    return std::nullopt;
+  }
+  return library_rom{.image = std::move(image),
+                     .profile = library->entry(*found).profile};
+}
@@ -0,0 +1,135 @@
+#ifndef SWIMP_ROM_LIBRARY_H
+#define SWIMP_ROM_LIBRARY_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "memory.hpp"
+#include "statemachine.hpp"
+
+/*
+ * Layout of a ROM library index file.
+ *
+ * A rom_index_header is followed by `entries` rom_index_entry records sorted
+ * by name, then `entries` uint32_t entry numbers sorted by content hash, then
+ * the names, then `images` memory images of statemachine::MEMORY_SIZE bytes
+ * with the font and program already in place. Images start on a 4 KiB
+ * boundary and identical programs share one. Offsets are from the start of
+ * the file and everything is in host byte order, since the index is a cache
+ * rebuilt from the ROMs rather than something to distribute.
+ */
+const static uint32_t ROM_INDEX_MAGIC = 0x49384843; // "CH8I"
+const static uint32_t ROM_INDEX_VERSION = 1;
+
+/// How to run a ROM, read from a `.profile` file next to it when indexed.
+struct rom_profile {
+  /// 0 means the frontend's default.
+  uint32_t cycles_per_frame;
+  /// Quirks to turn on, as a mask over QUIRKS in sweep.hpp.
+  uint32_t quirks;
+  /// The CHIP-8 key that keypad position i presses.
+  std::array<uint8_t, 16> keys;
+
+  /// Sets the quirks and, if given, the timer rate in `conf`.
+  void apply(statemachine::init_conf &conf) const;
+
+  /// Translates a keystate by keypad position into one by CHIP-8 key.
+  uint16_t map_keys(uint16_t keystate) const;
+
+  /// No quirks, the default speed and every key where it is.
+  static rom_profile defaults();
+};
+
+struct rom_index_header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t entries;
+  uint32_t images;
+  uint64_t by_hash_offset;
+  uint64_t names_offset;
+  uint64_t images_offset;
+  uint64_t size;
+};
+
+struct rom_index_entry {
+  /// FNV-1a of the program bytes.
+  uint64_t hash;
+  uint32_t name_offset;
+  uint16_t name_size;
+  uint16_t program_size;
+  uint32_t image;
+  rom_profile profile;
+};
+
+/// FNV-1a, as used for rom_index_entry::hash.
+uint64_t rom_hash(std::span<const uint8_t> program);
+
+/**
+ * Indexes every .ch8 file under `directory` into a new index at
+ * `index_path`, named by their path relative to the directory. A
+ * `<name>.profile` file next to a ROM may hold `quirks <name>...`,
+ * `cycles_per_frame <count>` and `keys <16 hex digits>` lines. The index is
+ * written to a temporary file and renamed into place, so readers of the old
+ * one are unaffected. Returns false if nothing could be written.
+ */
+bool build_rom_index(const std::string &directory,
+                     const std::string &index_path);
+
+/// A read-only mapping of an index built by build_rom_index().
+class rom_library {
+public:
+  /// Returns nullopt if the file can't be mapped or isn't a valid index.
+  static std::optional<rom_library> open(const std::string &index_path);
+
+  inline size_t size() const { return header().entries; }
+
+  inline const rom_index_entry &entry(size_t i) const { return entries()[i]; }
+
+  std::string_view name(size_t i) const;
+
+  std::optional<size_t> find(std::string_view name) const;
+  std::optional<size_t> find(uint64_t hash) const;
+
+  /**
+   * The memory image of entry `i`, pointing straight into the mapping. The
+   * mapping stays alive while any image or copy of the library does, so
+   * cow_statemachine can run from it without copying.
+   */
+  std::shared_ptr<const rom_image<statemachine::MEMORY_SIZE>>
+  image(size_t i) const;
+
+private:
+  rom_library(std::shared_ptr<const uint8_t> base) : m_base(std::move(base)) {}
+
+  inline const rom_index_header &header() const {
+    return *reinterpret_cast<const rom_index_header *>(m_base.get());
+  }
+  inline const rom_index_entry *entries() const {
+    return reinterpret_cast<const rom_index_entry *>(m_base.get() +
+                                                     sizeof(rom_index_header));
+  }
+  inline const uint32_t *by_hash() const {
+    return reinterpret_cast<const uint32_t *>(m_base.get() +
+                                              header().by_hash_offset);
+  }
+
+  std::shared_ptr<const uint8_t> m_base;
+};
+
+struct library_rom {
+  std::shared_ptr<const rom_image<statemachine::MEMORY_SIZE>> image;
+  rom_profile profile;
+};
+
+/// Opens the index at `index_path` and looks up `name` in it, logging why if
+/// that fails.
+std::optional<library_rom> load_from_library(const std::string &index_path,
+                                             std::string_view name);
+
+#endif // SWIMP_ROM_LIBRARY_H
@@ -0,0 +1,76 @@
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "font.hpp"
+#include "rom_library.hpp"
+
+static void write_file(const std::filesystem::path &path,
+                       const std::string &contents) {
+  std::ofstream out(path, std::ios::binary);
+  out << contents;
+}
+
+TEST(RomLibraryTest, TestIndexAndLoad) {
+  namespace fs = std::filesystem;
+  fs::path dir = fs::path(testing::TempDir()) / "rom_library_test";
+  fs::remove_all(dir);
+  fs::create_directories(dir / "sub");
+  const std::string pong("\x60\x01\x12\x00", 4);
+  write_file(dir / "pong.ch8", pong);
+  write_file(dir / "sub" / "copy.ch8", pong);
+  write_file(dir / "sub" / "other.ch8", "\x61\x02");
+  write_file(dir / "sub" / "other.profile", "# tuned by hand\n"
+                                             "quirks load_store\n"
+                                             "cycles_per_frame 20\n"
+                                             "keys 123C456D789EA0BF\n");
+  write_file(dir / "notes.txt", "not a ROM");
+  fs::path index = dir / "library.idx";
+  ASSERT_TRUE(build_rom_index(dir.string(), index.string()));
+
+  auto library = rom_library::open(index.string());
+  ASSERT_TRUE(library.has_value());
+  ASSERT_EQ(library->size(), 3);
+  ASSERT_EQ(library->name(0), "pong.ch8");
+  ASSERT_EQ(library->name(1), "sub/copy.ch8");
+  ASSERT_EQ(library->name(2), "sub/other.ch8");
+  ASSERT_EQ(library->find("sub/other.ch8"), 2);
+  ASSERT_FALSE(library->find("missing.ch8").has_value());
+
+  std::vector<uint8_t> other = {0x61, 0x02};
+  ASSERT_EQ(library->find(rom_hash(other)), 2);
+  ASSERT_EQ(library->entry(2).program_size, 2);
+
+  // Identical programs share one image, which has the font and the program
+  // in place.
+  auto image = library->image(0);
+  ASSERT_EQ(image.get(), library->image(1).get());
+  ASSERT_NE(image.get(), library->image(2).get());
+  ASSERT_TRUE(std::equal(font.begin(), font.end(), image->begin()));
+  ASSERT_EQ((*image)[0x200], 0x60);
+  ASSERT_EQ((*image)[0x202], 0x12);
+  ASSERT_EQ(library->entry(0).program_size, 4);
+
+  const rom_profile &profile = library->entry(2).profile;
+  ASSERT_EQ(profile.cycles_per_frame, 20);
+  statemachine::init_conf conf{.quirk_shift = true};
+  profile.apply(conf);
+  ASSERT_FALSE(conf.quirk_shift);
+  ASSERT_TRUE(conf.quirk_load_store);
+  ASSERT_EQ(conf.cycles_per_tick, 20);
+  // Keypad position 3 is CHIP-8 key C.
+  ASSERT_EQ(profile.map_keys(1u << 3), 1u << 0xC);
+  ASSERT_EQ(library->entry(0).profile.map_keys(1u << 3), 1u << 3);
+
+  // Images keep the mapping alive after the library itself is gone.
+  library.reset();
+  cow_statemachine machine(image, {.pc = 0x200});
+  ASSERT_EQ(machine.step(0), statemachine_common::NO_ERROR);
+  ASSERT_EQ(machine.regs()[0], 1);
+
+  write_file(index, "not an index");
+  ASSERT_FALSE(rom_library::open(index.string()).has_value());
+  fs::remove_all(dir);
+}
@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <condition_variable>
+#include <queue>
+#include <thread>
+
+#include "search.hpp"
+
+bool transposition_table::insert(uint64_t hash) {
+  // Shard on the top bits; unordered_set buckets on the low ones.
+  shard &s = m_shards[(hash >> 58) % SHARDS];
+  std::scoped_lock lk(s.mutex);
+  return s.hashes.insert(hash).second;
+}
+
+size_t transposition_table::size() const {
+  size_t total = 0;
+  for (const shard &s : m_shards) {
+    std::scoped_lock lk(s.mutex);
+    total += s.hashes.size();
+  }
+  return total;
+}
+
+namespace {
+
+/// Where a node came from; kept for every node so paths can be rebuilt.
+struct node_info {
+  size_t parent;
+  uint16_t action;
+  unsigned depth;
+  uint64_t score;
+};
+
+struct open_node {
+  size_t id;
+  uint64_t score;
+  unsigned depth;
+  cow_statemachine mach;
+
+  bool operator<(const open_node &other) const {
+    return score != other.score ? score < other.score : depth < other.depth;
+  }
+};
+
+class search_state {
+public:
+  search_state(const cow_statemachine &root, const search_config &conf)
+      : m_conf(conf) {
+    uint64_t root_score = score(root);
+    m_nodes.push_back(
+        {.parent = 0, .action = 0, .depth = 0, .score = root_score});
+    m_open.push({.id = 0, .score = root_score, .depth = 0, .mach = root});
+    m_table.insert(root.state_hash());
+  }
+
+  void work() {
+    std::vector<std::pair<uint16_t, open_node>> children;
+    for (;;) {
+      std::unique_lock lk(m_mutex);
+      m_wake.wait(lk, [this] {
+        return !m_open.empty() || m_busy == 0 ||
+               m_expanded >= m_conf.max_expansions;
+      });
+      if (m_open.empty() || m_expanded >= m_conf.max_expansions) {
+        // Nothing left, and nobody who could still produce more.
+        m_wake.notify_all();
+        return;
+      }
+      // Moving the machine out leaves the key fields that pop() compares.
+      open_node node = std::move(const_cast<open_node &>(m_open.top()));
+      m_open.pop();
+      ++m_expanded;
+      ++m_busy;
+      lk.unlock();
+
+      children.clear();
+      size_t transpositions = 0;
+      size_t dead_ends = 0;
+      for (uint16_t action : m_conf.actions) {
+        cow_statemachine child = node.mach;
+        if (!run(child, action)) {
+          ++dead_ends;
+        } else if (!m_table.insert(child.state_hash())) {
+          ++transpositions;
+        } else {
+          children.emplace_back(action, open_node{.id = 0,
+                                                  .score = score(child),
+                                                  .depth = node.depth + 1,
+                                                  .mach = std::move(child)});
+        }
+      }
+
+      lk.lock();
+      m_transpositions += transpositions;
+      m_dead_ends += dead_ends;
+      for (auto &[action, child] : children) {
+        child.id = m_nodes.size();
+        m_nodes.push_back({.parent = node.id,
+                           .action = action,
+                           .depth = child.depth,
+                           .score = child.score});
+        m_open.push(std::move(child));
+      }
+      --m_busy;
+      m_wake.notify_all();
+    }
+  }
+
+  search_result result() const {
+    // Highest score, then shallowest: the shortest way to the best state.
+    size_t best = 0;
+    for (size_t i = 1; i < m_nodes.size(); ++i) {
+      const node_info &n = m_nodes[i];
+      if (n.score > m_nodes[best].score ||
+          (n.score == m_nodes[best].score && n.depth < m_nodes[best].depth)) {
+        best = i;
+      }
+    }
+
+    search_result ret{.score = m_nodes[best].score,
+                      .expanded = m_expanded,
+                      .transpositions = m_transpositions,
+                      .dead_ends = m_dead_ends};
+    for (size_t i = best; i != 0; i = m_nodes[i].parent) {
+      ret.actions.push_back(m_nodes[i].action);
+    }
+    std::reverse(ret.actions.begin(), ret.actions.end());
+    return ret;
+  }
+
+private:
+  uint64_t score(const cow_statemachine &mach) const {
+    const auto &mem = mach.backing_memory();
+    uint64_t ret = 0;
+    for (uint16_t addr : m_conf.score_addresses) {
+      ret = (ret << 8) | mem.read(addr & cow_statemachine::ADDRESS_MASK);
+    }
+    return ret;
+  }
+
+  /// Runs one action. Returns false if the machine reported an error.
+  bool run(cow_statemachine &mach, uint16_t keystate) const {
+    uint64_t per_frame = m_conf.cycles_per_frame;
+    uint64_t end = (mach.cycles() / per_frame + m_conf.frames_per_action) *
+                   per_frame;
+    while (mach.cycles() < end) {
+      auto status = mach.step(keystate);
+      if (status == statemachine_common::WAITING_FOR_KEYPRESS) {
+        mach.idle_until(end);
+      } else if (status < 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  const search_config &m_conf;
+  transposition_table m_table;
+
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::priority_queue<open_node> m_open;
+  std::vector<node_info> m_nodes;
+  size_t m_expanded = 0;
+  size_t m_transpositions = 0;
+  size_t m_dead_ends = 0;
+  /// Threads currently expanding a node.
+  unsigned m_busy = 0;
+};
+
+} // namespace
+
+search_result best_first_search(const cow_statemachine &root,
+                                const search_config &conf) {
+  search_state state(root, conf);
+  std::vector<std::thread> workers;
+  for (unsigned i = 1; i < std::max(conf.threads, 1u); ++i) {
+    workers.emplace_back(&search_state::work, &state);
+  }
+  state.work();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  return state.result();
+}
@@ -0,0 +1,70 @@
+#ifndef SWIMP_SEARCH_H
+#define SWIMP_SEARCH_H
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include "statemachine.hpp"
+
+/// Set of state hashes shared by all search threads, sharded to keep lock
+/// contention down.
+class transposition_table {
+public:
+  /// Returns false if `hash` was already present.
+  bool insert(uint64_t hash);
+
+  size_t size() const;
+
+private:
+  const static unsigned SHARDS = 64;
+
+  struct shard {
+    mutable std::mutex mutex;
+    std::unordered_set<uint64_t> hashes;
+  };
+
+  std::array<shard, SHARDS> m_shards;
+};
+
+struct search_config {
+  /// Keystates to choose between at every node.
+  std::vector<uint16_t> actions;
+  /// Frames each action is held for.
+  unsigned frames_per_action = 4;
+  uint32_t cycles_per_frame = 700 / 60;
+  /// Bytes that make up the score, most significant first.
+  std::vector<uint16_t> score_addresses;
+  /// Nodes to expand before giving up.
+  size_t max_expansions = 10000;
+  unsigned threads = 1;
+};
+
+struct search_result {
+  /// Keystates leading to the best-scoring state found.
+  std::vector<uint16_t> actions;
+  uint64_t score = 0;
+  size_t expanded = 0;
+  /// Children dropped because an identical state had already been reached.
+  size_t transpositions = 0;
+  /// Children dropped because the machine reported an error.
+  size_t dead_ends = 0;
+};
+
+/**
+ * Best-first search over sequences of keystates.
+ *
+ * Each expansion clones the node's machine once per action and runs the
+ * clone for frames_per_action frames. A child is kept only if its
+ * state_hash() is new to the transposition table, so the many inputs a game
+ * ignores collapse into one node. Worker threads each pop the best node
+ * (highest score, then deepest), expand it and push the children. Machines
+ * are copy-on-write, so a node costs its display and page table plus the
+ * pages it has written.
+ */
+search_result best_first_search(const cow_statemachine &root,
+                                const search_config &conf);
+
+#endif // SWIMP_SEARCH_H
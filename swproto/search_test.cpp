@@ -0,0 +1,41 @@
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <memory>
+
+#include "search.hpp"
+
+TEST(SearchTest, TestFindsScoringKey) {
+  // Counts iterations at 0x300 while key 5 is held.
+  rom_image<cow_statemachine::MEMORY_SIZE> rom{};
+  const uint16_t program[] = {
+      0x6505, // LD V5, 5
+      0xE5A1, // SKNP V5
+      0x7001, // ADD V0, 1
+      0xA300, // LD I, 0x300
+      0xF055, // LD [I], V0
+      0x1202, // JP 0x202
+  };
+  for (size_t i = 0; i < std::size(program); ++i) {
+    rom[0x200 + 2 * i] = program[i] >> 8;
+    rom[0x201 + 2 * i] = program[i] & 0xFF;
+  }
+  cow_statemachine root(
+      std::make_shared<const rom_image<cow_statemachine::MEMORY_SIZE>>(rom),
+      {.pc = 0x200});
+
+  search_config conf{.score_addresses = {0x300},
+                     .max_expansions = 20,
+                     .threads = 4};
+  for (unsigned key = 0; key < 16; ++key) {
+    conf.actions.push_back(1u << key);
+  }
+  auto result = best_first_search(root, conf);
+
+  ASSERT_EQ(result.expanded, 20);
+  ASSERT_GT(result.score, 0);
+  // Every key but 5 leads to the same state as every other.
+  ASSERT_GE(result.transpositions, 14 * 20);
+  ASSERT_EQ(result.dead_ends, 0);
+  ASSERT_FALSE(result.actions.empty());
+  ASSERT_EQ(result.actions.front(), 1u << 5);
+}
@@ -0,0 +1,71 @@
+#ifndef SWIMP_SPSC_RING_H
+#define SWIMP_SPSC_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <type_traits>
+
+/**
+ * Bounded lock-free ring for exactly one producer thread and one consumer
+ * thread. Neither side ever blocks: push() stores as much as fits and pop()
+ * takes as much as is available.
+ */
+template <class T> class spsc_ring {
+  static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+  /// Holds at most `capacity` elements. The storage behind them is rounded
+  /// up to a power of two, but only so that positions can be masked.
+  explicit spsc_ring(size_t capacity)
+      : m_capacity(std::max<size_t>(capacity, 1)),
+        m_mask(std::bit_ceil(m_capacity) - 1),
+        m_buffer(new T[m_mask + 1]) {}
+
+  inline size_t capacity() const { return m_capacity; }
+
+  /// Number of elements currently queued. Only exact on the consumer side.
+  inline size_t size() const {
+    return m_head.load(std::memory_order_acquire) -
+           m_tail.load(std::memory_order_acquire);
+  }
+
+  /// Producer side. Returns how many elements were queued.
+  size_t push(std::span<const T> items) {
+    size_t head = m_head.load(std::memory_order_relaxed);
+    size_t tail = m_tail.load(std::memory_order_acquire);
+    size_t count = std::min(items.size(), m_capacity - (head - tail));
+    size_t begin = head & m_mask;
+    size_t first = std::min(count, m_mask + 1 - begin);
+    std::copy_n(items.data(), first, m_buffer.get() + begin);
+    std::copy_n(items.data() + first, count - first, m_buffer.get());
+    m_head.store(head + count, std::memory_order_release);
+    return count;
+  }
+
+  /// Consumer side. Returns how many elements were dequeued.
+  size_t pop(std::span<T> items) {
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    size_t head = m_head.load(std::memory_order_acquire);
+    size_t count = std::min(items.size(), head - tail);
+    size_t begin = tail & m_mask;
+    size_t first = std::min(count, m_mask + 1 - begin);
+    std::copy_n(m_buffer.get() + begin, first, items.data());
+    std::copy_n(m_buffer.get(), count - first, items.data() + first);
+    m_tail.store(tail + count, std::memory_order_release);
+    return count;
+  }
+
+private:
+  const size_t m_capacity;
+  const size_t m_mask;
+  std::unique_ptr<T[]> m_buffer;
+  // Free-running positions; only their difference is meaningful.
+  alignas(64) std::atomic<size_t> m_head{0};
+  alignas(64) std::atomic<size_t> m_tail{0};
+};
+
+#endif // SWIMP_SPSC_RING_H
@@ -0,0 +1,73 @@
+#include <array>
+#include <gtest/gtest.h>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "spsc_ring.hpp"
+
+TEST(SpscRingTest, TestPartialPushPopAndWraparound) {
+  // Stored in 8 slots, but never holds more than 5.
+  spsc_ring<int> ring(5);
+  ASSERT_EQ(ring.capacity(), 5);
+
+  std::vector<int> items(10);
+  std::iota(items.begin(), items.end(), 0);
+  ASSERT_EQ(ring.push(items), 5) << "only what fits is queued";
+  ASSERT_EQ(ring.size(), 5);
+
+  std::array<int, 5> out{};
+  ASSERT_EQ(ring.pop(out), 5);
+  ASSERT_EQ(out, (std::array<int, 5>{0, 1, 2, 3, 4}));
+
+  // These land in slots 5-7 and wrap around to 0-1.
+  ASSERT_EQ(ring.push(std::span(items).subspan(5)), 5);
+  ASSERT_EQ(ring.push(std::span(items).first(1)), 0) << "full at 5";
+
+  std::array<int, 3> some{};
+  ASSERT_EQ(ring.pop(some), 3);
+  ASSERT_EQ(some, (std::array<int, 3>{5, 6, 7}));
+  ASSERT_EQ(ring.push(std::span(items).first(4)), 3);
+  ASSERT_EQ(ring.size(), 5);
+
+  std::array<int, 16> rest{};
+  ASSERT_EQ(ring.pop(rest), 5);
+  ASSERT_EQ(std::vector<int>(rest.begin(), rest.begin() + 5),
+            (std::vector<int>{8, 9, 0, 1, 2}));
+  ASSERT_EQ(ring.pop(rest), 0) << "empty";
+  ASSERT_EQ(ring.size(), 0);
+}
+
+TEST(SpscRingTest, TestTwoThreadsKeepOrder) {
+  const uint32_t total = 200000;
+  spsc_ring<uint32_t> ring(64);
+
+  std::thread producer([&ring, total] {
+    std::array<uint32_t, 37> chunk;
+    for (uint32_t next = 0; next < total;) {
+      size_t count = std::min<size_t>(chunk.size(), total - next);
+      std::iota(chunk.begin(), chunk.begin() + count, next);
+      size_t pushed = ring.push(std::span(chunk).first(count));
+      next += pushed;
+      if (pushed < count) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  std::array<uint32_t, 23> chunk;
+  uint32_t expected = 0;
+  bool in_order = true;
+  while (expected < total) {
+    size_t count = ring.pop(chunk);
+    if (count == 0) {
+      std::this_thread::yield();
+    }
+    for (size_t i = 0; i < count; ++i) {
+      in_order &= chunk[i] == expected++;
+    }
+  }
+  producer.join();
+  ASSERT_TRUE(in_order);
+  ASSERT_EQ(ring.size(), 0);
+}
@@ -1,31 +1,33 @@
 #ifndef SWIMP_STATEMACHINE_H
 #define SWIMP_STATEMACHINE_H
 
+#include <algorithm>
 #include <array>
+#include <cassert>
 #include <cstdint>
 #include <initializer_list>
 #include <span>
-#include <stack>
+#include <type_traits>
 #include <vector>
 
-class statemachine {
-public:
-  const static unsigned MEMORY_SIZE = 4096;
-  const static unsigned STACK_SIZE = 16;
-  const static unsigned DISPLAY_WIDTH = 64;
-  const static unsigned ROW_SIZE = DISPLAY_WIDTH / 8;
-  const static unsigned DISPLAY_HEIGHT = 32;
-  const static unsigned ROW_MASK = DISPLAY_HEIGHT - 1;
-  const static unsigned ROW_OFFSET_MASK = ROW_SIZE - 1;
-  const static unsigned DISPLAY_SIZE = ROW_SIZE * DISPLAY_HEIGHT;
-  const static unsigned PROG_BEGIN = 0x200;
+#include "cycle_costs.hpp"
+#include "font.hpp"
+#include "log.hpp"
+#include "memory.hpp"
+
+/// Logs the instruction about to run, once per run of the same pc.
+void trace_instruction(uint16_t pc, uint16_t opcode);
 
+/// Types shared by machines of every geometry.
+struct statemachine_common {
   // Non-negative statuses are those from which the state machine may recover.
   // Negative statuses are those with overflows.
   enum status {
     NO_ERROR = 0,
     NOT_IMPLEMENTED = 1,
     WAITING_FOR_KEYPRESS = 2,
+    BREAKPOINT = 3, // Stopped before the instruction at pc().
+    WATCHPOINT = 4, // Stopped after the instruction; see last_watch_hit().
     POPPED_EMPTY_STACK = -2,
     PUSHED_FULL_STACK = -3,
     MEMORY_OVERFLOW = -5,
@@ -35,79 +37,1108 @@ public:
     DEBUG_ERROR = -100, // Thrown for testing purposes.
   };
 
+  /// 700 instructions per second with 60Hz timers.
+  constexpr static uint32_t DEFAULT_CYCLES_PER_TICK = 700 / 60;
+
   struct init_conf {
     uint16_t pc;
     uint16_t font_begin;
+    /// Cycles between 60Hz timer ticks; 0 means the cost model's
+    /// cycles_per_frame, or DEFAULT_CYCLES_PER_TICK without one.
+    uint32_t cycles_per_tick;
     bool quirk_shift : 1;
     bool quirk_load_store : 1;
+    /// Execute common instruction pairs and loops in a single step().
+    bool fuse_instructions : 1;
+    /// Seed for Cxkk; 0 picks a fixed default.
+    uint32_t seed;
+    /// Per-instruction cycle costs; nullptr counts every instruction as one
+    /// cycle. Must outlive the machine and its copies.
+    const cycle_costs *costs;
+  };
+
+  /// Kinds of memory access, usable as a mask.
+  enum access : uint8_t {
+    ACCESS_READ = 1,
+    ACCESS_WRITE = 2,
+  };
+
+  /// Operand of a conditional breakpoint that refers to I rather than Vx.
+  constexpr static uint8_t BREAK_ON_I = 0x10;
+  /// Operand of an unconditional breakpoint.
+  constexpr static uint8_t BREAK_ALWAYS = 0xFF;
+
+  struct breakpoint {
+    uint16_t pc;
+    /// 0-15 for Vx, BREAK_ON_I or BREAK_ALWAYS.
+    uint8_t operand = BREAK_ALWAYS;
+    /// Only break if the operand holds this value.
+    uint16_t value = 0;
   };
 
-  statemachine(std::array<uint8_t, MEMORY_SIZE> mem, init_conf conf = {});
+  /// Matches Dxyn/Fx65 reads and Fx33/Fx55 writes of [begin, end).
+  struct watchpoint {
+    uint16_t begin;
+    uint32_t end;
+    uint8_t mask = ACCESS_READ | ACCESS_WRITE;
+  };
 
-  statemachine(std::initializer_list<uint16_t> instructions,
-               init_conf conf = {});
+  struct watch_hit {
+    uint16_t addr;
+    access kind;
+  };
+};
+
+/**
+ * CHIP-8 interpreter whose display and memory size are fixed at compile time,
+ * so each geometry gets its own constant masks and exactly-sized arrays.
+ *
+ * Machines wider than 64 pixels additionally understand the SUPER-CHIP scroll
+ * instructions 00Cn, 00FB and 00FC.
+ *
+ * With init_conf::fuse_instructions set, step() recognises a few common
+ * sequences (Annn/Fx29 followed by Dxyn, Fx33 followed by Fx65, and the
+ * 7xkk; 3ykk/4ykk; 1nnn counting loop) and executes them at once. cycles()
+ * still advances by each instruction's cost, so callers that budget by cycles
+ * see the same timing either way.
+ *
+ * Every instruction costs one cycle unless init_conf::costs supplies a cost
+ * model, in which case a frame's worth of cycles is a frame of that
+ * interpreter's time rather than a fixed instruction count.
+ *
+ * Breakpoints and watchpoints are looked up only on 256-byte pages that have
+ * one, so an armed debugger costs a table lookup per instruction elsewhere.
+ *
+ * @tparam Width Display width in pixels, a multiple of 64.
+ * @tparam Height Display height in pixels, a power of two.
+ * @tparam MemorySize Bytes of memory, a power of two no larger than 64 KiB.
+ * @tparam Memory How memory is stored; see memory.hpp.
+ */
+template <unsigned Width, unsigned Height, unsigned MemorySize,
+          class Memory = flat_memory<MemorySize>>
+class basic_statemachine : public statemachine_common {
+public:
+  static_assert(Width % 64 == 0, "rows must be whole 64-bit words");
+  static_assert((Height & (Height - 1)) == 0, "height must be a power of 2");
+  static_assert((MemorySize & (MemorySize - 1)) == 0 &&
+                    MemorySize <= 0x10000,
+                "memory must be a power of 2 addressable by 16 bits");
+
+  constexpr static unsigned MEMORY_SIZE = MemorySize;
+  constexpr static unsigned ADDRESS_MASK = MEMORY_SIZE - 1;
+  constexpr static unsigned STACK_SIZE = 16;
+  constexpr static unsigned DISPLAY_WIDTH = Width;
+  constexpr static unsigned ROW_SIZE = DISPLAY_WIDTH / 8;
+  constexpr static unsigned ROW_WORDS = DISPLAY_WIDTH / 64;
+  constexpr static unsigned DISPLAY_HEIGHT = Height;
+  constexpr static unsigned ROW_MASK = DISPLAY_HEIGHT - 1;
+  constexpr static unsigned ROW_OFFSET_MASK = ROW_SIZE - 1;
+  constexpr static unsigned DISPLAY_SIZE = ROW_SIZE * DISPLAY_HEIGHT;
+  constexpr static unsigned PROG_BEGIN = 0x200;
+  constexpr static unsigned DEBUG_PAGE_SIZE = 256;
+  /// Granularity of write tracking: 64 pages for 4 KiB, 256 for 64 KiB.
+  constexpr static unsigned DIRTY_PAGE_SIZE = MEMORY_SIZE <= 0x1000 ? 64 : 256;
+  constexpr static unsigned DIRTY_PAGES =
+      (MEMORY_SIZE + DIRTY_PAGE_SIZE - 1) / DIRTY_PAGE_SIZE;
+
+  /// Memory is constructible from a rom_image, and for cow_memory from a
+  /// shared pointer to one.
+  constexpr basic_statemachine(Memory mem, init_conf conf = {});
+
+  constexpr basic_statemachine(std::initializer_list<uint16_t> instructions,
+                               init_conf conf = {});
 
   /**
-   * Executes one instruction
-   * @param ticks Number of 60Hz whole ticks that have passed since the last
-   * invocation.
+   * Executes one instruction. The timers tick once every cycles_per_tick
+   * cycles, however the caller batches steps.
    */
-  status step(uint16_t keystate, bool tick);
+  constexpr status step(uint16_t keystate);
 
   /// Get current value of special register I.
-  inline uint16_t reg_I() const { return m_reg_I; };
+  constexpr uint16_t reg_I() const { return m_reg_I; };
 
   /// Get current value of delay timer register.
-  inline uint8_t reg_DT() const { return m_reg_DT; };
+  constexpr uint8_t reg_DT() const { return timer_value(m_reg_DT, m_DT_tick); };
 
   /// Get current value of sound timer register.
-  inline uint8_t reg_ST() const { return m_reg_ST; };
+  constexpr uint8_t reg_ST() const { return timer_value(m_reg_ST, m_ST_tick); };
 
   /// Get current display
-  inline const std::array<uint8_t, DISPLAY_SIZE> display() const {
+  constexpr const std::array<uint8_t, DISPLAY_SIZE> display() const {
     return m_display;
   };
 
   /// Get current memory
-  inline std::span<const uint8_t, MEMORY_SIZE> memory() const { return m_mem; };
+  constexpr auto memory() const { return m_mem.view(); };
+
+  /// Get the memory policy object itself.
+  constexpr const Memory &backing_memory() const { return m_mem; };
 
   /// Get current registers
-  inline std::span<const uint8_t, 16> regs() const { return m_regs; };
+  constexpr std::span<const uint8_t, 16> regs() const { return m_regs; };
 
   /// Get current program counter.
-  inline uint16_t pc() const { return m_pc; };
+  constexpr uint16_t pc() const { return m_pc; };
+
+  /// Get number of instructions executed (including key waits) so far.
+  constexpr uint64_t cycles() const { return m_cycles; };
+
+  /// Advances cycles() to `cycle`, as if the machine had spent the time
+  /// waiting on Fx0A.
+  constexpr void idle_until(uint64_t cycle) {
+    m_cycles = std::max(m_cycles, cycle);
+  };
+
+  /// Get a counter that is bumped whenever 00E0 or Dxyn changes the display.
+  constexpr uint64_t display_generation() const {
+    return m_display_generation;
+  };
+
+  /**
+   * Get a bitmap of the DIRTY_PAGE_SIZE pages written by Fx33 or Fx55 since
+   * the last clear_dirty_pages(). Bit `p % 64` of word `p / 64` is page p.
+   */
+  constexpr std::span<const uint64_t> dirty_pages() const { return m_dirty; };
+
+  /// Starts a new epoch for dirty_pages().
+  constexpr void clear_dirty_pages() { m_dirty.fill(0); };
+
+  /// Get a counter that is bumped by every write to the given page.
+  constexpr uint32_t page_generation(unsigned page) const {
+    return m_page_generation.at(page);
+  };
+
+  /**
+   * Get a 64-bit fingerprint of everything that determines how the machine
+   * runs from here: memory, display, registers, I, PC, timers, stack and the
+   * Cxkk generator. Equal states have equal hashes regardless of how they
+   * were reached or of cycles().
+   *
+   * Memory and display are hashed incrementally as they are written, so this
+   * costs a few dozen mixes no matter how large the machine is.
+   */
+  constexpr uint64_t state_hash() const;
+
+  /// The display's part of state_hash(), for telling visible differences
+  /// from internal ones.
+  constexpr uint64_t display_hash() const { return m_display_hash; }
+
+  /// Writes bytes to memory starting at `addr` as if the program had stored
+  /// them, e.g. to load a program into a copy of a prepared machine.
+  constexpr void poke(uint16_t addr, std::span<const uint8_t> bytes) {
+    for (uint8_t byte : bytes) {
+      addr &= ADDRESS_MASK;
+      write_memory(addr, byte);
+      mark_dirty(addr, 1);
+      ++addr;
+    }
+  }
 
   /// Get current stack
-  inline std::span<const uint16_t> stack() const {
+  constexpr std::span<const uint16_t> stack() const {
     return m_stack.const_view();
   };
 
-  inline uint16_t curr_instruction() const {
-    return (static_cast<uint16_t>(m_mem[m_pc]) << 8) |
-           static_cast<uint16_t>(m_mem[m_pc + 1]);
+  /**
+   * step() returns BREAKPOINT instead of executing the instruction at bp.pc
+   * while the condition holds. The next step() after a break executes that
+   * instruction, so callers simply keep stepping to resume.
+   */
+  constexpr void add_breakpoint(breakpoint bp);
+
+  /// Removes every breakpoint at `pc`.
+  constexpr void remove_breakpoint(uint16_t pc);
+
+  /// step() returns WATCHPOINT after executing an instruction that accessed
+  /// the watched range.
+  constexpr void add_watchpoint(watchpoint wp);
+
+  constexpr void clear_watchpoints();
+
+  /// The access that caused the last WATCHPOINT status.
+  constexpr watch_hit last_watch_hit() const { return m_last_watch_hit; };
+
+  constexpr uint16_t curr_instruction() const {
+    return (static_cast<uint16_t>(m_mem.read(m_pc)) << 8) |
+           static_cast<uint16_t>(m_mem.read((m_pc + 1) & ADDRESS_MASK));
   }
 
 private:
-  class instruction_stack : public std::stack<uint16_t, std::vector<uint16_t>> {
+  /// Number of timer ticks up to and including the current cycle.
+  constexpr uint64_t ticks() const {
+    return (m_cycles + m_cycles_per_tick - 1) / m_cycles_per_tick;
+  }
+
+  /// Value of a timer that was set to `value` at tick `since`.
+  constexpr uint8_t timer_value(uint8_t value, uint64_t since) const {
+    uint64_t elapsed = ticks() - since;
+    return elapsed >= value ? 0 : value - elapsed;
+  }
+
+  /// Returns the opcode at `addr`, or 0 if it runs past the end of memory.
+  constexpr uint16_t peek_opcode(uint32_t addr) const;
+
+  /// Cycles `opcode` adds to cycles(), given the registers as they are now.
+  constexpr uint32_t instruction_cost(uint16_t opcode) const {
+    return m_costs ? m_costs->cost(opcode, m_regs[(opcode >> 8) & 0xF]) : 1;
+  }
+
+  /// Dxyn
+  constexpr status draw_sprite(uint8_t x, uint8_t y, uint8_t n);
+
+  /// Fx33
+  constexpr status store_bcd(uint8_t x);
+
+  /// Fx55
+  constexpr status store_registers(uint8_t x);
+
+  /// Fx65
+  constexpr status load_registers(uint8_t x);
+
+  /// Records a write to [addr, addr + len), len <= DIRTY_PAGE_SIZE.
+  constexpr void mark_dirty(uint16_t addr, unsigned len) {
+    unsigned first = (addr & ADDRESS_MASK) / DIRTY_PAGE_SIZE;
+    unsigned last = ((addr + len - 1) & ADDRESS_MASK) / DIRTY_PAGE_SIZE;
+    m_dirty[first / 64] |= uint64_t{1} << (first % 64);
+    ++m_page_generation[first];
+    if (last != first) {
+      m_dirty[last / 64] |= uint64_t{1} << (last % 64);
+      ++m_page_generation[last];
+    }
+  }
+
+  /// Contribution of `value` at `pos` to a state hash. Zero values
+  /// contribute nothing, so a cleared display hashes to 0.
+  constexpr static uint64_t hash_term(uint32_t pos, uint16_t value) {
+    if (!value) {
+      return 0;
+    }
+    // splitmix64 finalizer.
+    uint64_t z = ((uint64_t{pos} << 16) | value) * 0x9E3779B97F4A7C15;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+    return z ^ (z >> 31);
+  }
+
+  /// Writes a byte of memory, keeping the memory hash current.
+  constexpr void write_memory(uint16_t addr, uint8_t value) {
+    m_memory_hash ^= hash_term(addr, m_mem.read(addr)) ^ hash_term(addr, value);
+    m_mem.write(addr, value);
+  }
+
+  /// Replaces a display byte, keeping the display hash current.
+  constexpr void write_display(size_t idx, uint8_t value) {
+    uint32_t pos = MEMORY_SIZE + idx;
+    m_display_hash ^= hash_term(pos, m_display[idx]) ^ hash_term(pos, value);
+    m_display[idx] = value;
+  }
+
+  /// Recompute the hashes from scratch, after bulk changes.
+  constexpr void rehash_memory();
+  constexpr void rehash_display();
+
+  /// Returns true if a breakpoint at the current pc applies.
+  constexpr bool breakpoint_hit() const;
+
+  /// Returns true and records the hit if [addr, addr + len) is watched.
+  constexpr bool watch(uint16_t addr, unsigned len, access kind);
+
+  /// Recomputes m_debug_pages from the breakpoint and watchpoint lists.
+  constexpr void update_debug_pages();
+
+  /// Shifts every row of the display by the given number of pixels.
+  constexpr void scroll_horizontal(int pixels);
+
+  /// Shifts the display down by the given number of rows.
+  constexpr void scroll_down(unsigned rows);
+
+  /// Fixed-capacity call stack.
+  class instruction_stack {
   public:
-    std::span<const uint16_t> const_view() const;
+    constexpr bool empty() const { return m_size == 0; }
+    constexpr size_t size() const { return m_size; }
+    constexpr uint16_t top() const { return m_entries[m_size - 1]; }
+    constexpr void push(uint16_t addr) { m_entries[m_size++] = addr; }
+    constexpr void pop() { --m_size; }
+    constexpr std::span<const uint16_t> const_view() const {
+      return {m_entries.data(), m_size};
+    }
+
+  private:
+    std::array<uint16_t, STACK_SIZE> m_entries{};
+    size_t m_size = 0;
   };
 
-  std::array<uint8_t, MEMORY_SIZE> m_mem;
+  Memory m_mem;
   std::array<uint8_t, DISPLAY_SIZE> m_display;
   std::array<uint8_t, 16> m_regs;
   instruction_stack m_stack;
   uint16_t m_pc;
+  uint64_t m_cycles;
+  uint64_t m_display_generation;
   uint16_t m_font_begin;
   uint16_t m_reg_I;
-  // Timer registers.
+  // Timer registers, as last set. Their current values are derived from the
+  // number of ticks since then.
   uint8_t m_reg_DT; // delay timer.
   uint8_t m_reg_ST; // sound timer
+  uint64_t m_DT_tick;
+  uint64_t m_ST_tick;
+  uint32_t m_cycles_per_tick;
   /* Quirk behavior detailed in
    * http://mir3z.github.io/chip8-emu/doc/chip8-cpu.js.html#sunlight-1-line-119
    */
   bool m_quirk_shift : 1;
   bool m_quirk_load_store : 1;
+  bool m_fuse_instructions : 1;
+
+  constexpr static uint8_t PAGE_BREAKPOINT = 4;
+  constexpr static uint32_t NO_RESUME = UINT32_MAX;
+  /// Per page: PAGE_BREAKPOINT and the access bits of any watchpoints on it.
+  std::array<uint8_t, (MEMORY_SIZE + DEBUG_PAGE_SIZE - 1) / DEBUG_PAGE_SIZE>
+      m_debug_pages;
+  std::vector<breakpoint> m_breakpoints;
+  std::vector<watchpoint> m_watchpoints;
+  /// Breakpoint address just reported, which the next step() executes.
+  uint32_t m_resume_pc;
+  watch_hit m_last_watch_hit;
+
+  std::array<uint64_t, (DIRTY_PAGES + 63) / 64> m_dirty;
+  std::array<uint32_t, DIRTY_PAGES> m_page_generation;
+  uint32_t m_rng;
+  /// XOR of hash_term() over every byte of memory and of the display.
+  uint64_t m_memory_hash;
+  uint64_t m_display_hash;
+  const cycle_costs *m_costs;
 };
 
+/// The original 64x32 CHIP-8 with 4 KiB of memory.
+using statemachine = basic_statemachine<64, 32, 0x1000>;
+
+/// SUPER-CHIP high-resolution geometry.
+using schip_statemachine = basic_statemachine<128, 64, 0x1000>;
+
+/// XO-CHIP high-resolution geometry with 64 KiB of memory.
+using xochip_statemachine = basic_statemachine<128, 64, 0x10000>;
+
+/// Classic machine sharing its ROM image with other instances.
+using cow_statemachine =
+    basic_statemachine<64, 32, 0x1000, cow_memory<0x1000>>;
+
+template <unsigned MemorySize>
+constexpr std::array<uint8_t, MemorySize>
+instructions_decode(const std::initializer_list<uint16_t> instructions) {
+
+  assert(instructions.size() <= (MemorySize / 2));
+
+  std::array<uint8_t, MemorySize> mem{0};
+  unsigned i = 0;
+  for (uint16_t instruction : instructions) {
+    // Necessary to do it this way b/c of endianness correctness.
+    mem[i++] = instruction >> 8;
+    mem[i++] = instruction & 0xFF;
+  }
+
+  return mem;
+}
+
+/// Loads 64 display pixels, leftmost pixel in the most significant bit.
+constexpr uint64_t load_row_word(const uint8_t *bytes) {
+  uint64_t word = 0;
+  for (unsigned i = 0; i < 8; ++i) {
+    word = (word << 8) | bytes[i];
+  }
+  return word;
+}
+
+/// Inverse of load_row_word.
+constexpr void store_row_word(uint8_t *bytes, uint64_t word) {
+  for (unsigned i = 8; i-- > 0; word >>= 8) {
+    bytes[i] = word & 0xFF;
+  }
+}
+
+template <unsigned Width, unsigned Height, unsigned MemorySize, class Memory>
+constexpr basic_statemachine<Width, Height, MemorySize, Memory>::
+    basic_statemachine(Memory mem, init_conf conf)
+    : m_mem(std::move(mem)), m_display{0}, m_regs{0}, m_stack{},
+      m_pc(conf.pc), m_cycles(0), m_display_generation(0),
+      m_font_begin(conf.font_begin), m_reg_I(0), m_reg_DT(0), m_reg_ST(0),
+      m_DT_tick(0), m_ST_tick(0),
+      m_cycles_per_tick(conf.cycles_per_tick ? conf.cycles_per_tick
+                        : conf.costs         ? conf.costs->cycles_per_frame
+                                             : DEFAULT_CYCLES_PER_TICK),
+      m_quirk_shift(conf.quirk_shift),
+      m_quirk_load_store(conf.quirk_load_store),
+      m_fuse_instructions(conf.fuse_instructions), m_debug_pages{0},
+      m_resume_pc(NO_RESUME), m_last_watch_hit{}, m_dirty{0},
+      m_page_generation{0}, m_rng(conf.seed ? conf.seed : 0x2545F491),
+      m_memory_hash(0), m_display_hash(0), m_costs(conf.costs) {
+  rehash_memory();
+}
+
+template <unsigned Width, unsigned Height, unsigned MemorySize, class Memory>
+constexpr basic_statemachine<Width, Height, MemorySize, Memory>::
+    basic_statemachine(std::initializer_list<uint16_t> instructions,
+                       init_conf conf)
+    : m_mem(instructions_decode<MEMORY_SIZE>(instructions)), m_display{0},
+      m_regs{0}, m_stack{}, m_pc(conf.pc), m_cycles(0),
+      m_display_generation(0), m_font_begin(conf.font_begin), m_reg_I(0),
+      m_reg_DT(0), m_reg_ST(0), m_DT_tick(0), m_ST_tick(0),
+      m_cycles_per_tick(conf.cycles_per_tick ? conf.cycles_per_tick
+                        : conf.costs         ? conf.costs->cycles_per_frame
+                                             : DEFAULT_CYCLES_PER_TICK),
+      m_quirk_shift(conf.quirk_shift),
+      m_quirk_load_store(conf.quirk_load_store),
+      m_fuse_instructions(conf.fuse_instructions), m_debug_pages{0},
+      m_resume_pc(NO_RESUME), m_last_watch_hit{}, m_dirty{0},
+      m_page_generation{0}, m_rng(conf.seed ? conf.seed : 0x2545F491),
+      m_memory_hash(0), m_display_hash(0), m_costs(conf.costs) {
+  rehash_memory();
+}
+
+template <unsigned Width, unsigned Height, unsigned MemorySize, class Memory>
+constexpr void
+basic_statemachine<Width, Height, MemorySize, Memory>::scroll_horizontal(
+    int pixels) {
+  for (unsigned row = 0; row < DISPLAY_HEIGHT; ++row) {
+    uint8_t *row_bytes = m_display.data() + row * ROW_SIZE;
+    std::array<uint64_t, ROW_WORDS> words;
+    for (unsigned w = 0; w < ROW_WORDS; ++w) {
+      words[w] = load_row_word(row_bytes + w * 8);
+    }
+
+    // Shift whole words, carrying bits across word boundaries.
+    if (pixels > 0) {
+      for (unsigned w = ROW_WORDS; w-- > 0;) {
+        uint64_t carry = w ? words[w - 1] << (64 - pixels) : 0;
+        words[w] = (words[w] >> pixels) | carry;
+      }
+    } else {
+      for (unsigned w = 0; w < ROW_WORDS; ++w) {
+        uint64_t carry = (w + 1 < ROW_WORDS) ? words[w + 1] >> (64 + pixels)
+                                             : 0;
+        words[w] = (words[w] << -pixels) | carry;
+      }
+    }
+
+    for (unsigned w = 0; w < ROW_WORDS; ++w) {
+      store_row_word(row_bytes + w * 8, words[w]);
+    }
+  }
+  rehash_display();
+}
+
+template <unsigned Width, unsigned Height, unsigned MemorySize, class Memory>
+constexpr void
+basic_statemachine<Width, Height, MemorySize, Memory>::scroll_down(
+    unsigned rows) {
+  rows = std::min(rows, DISPLAY_HEIGHT);
+  std::copy_backward(m_display.begin(), m_display.end() - rows * ROW_SIZE,
+                     m_display.end());
+  std::fill_n(m_display.begin(), rows * ROW_SIZE, 0);
+  rehash_display();
+}
+
+template <unsigned Width, unsigned Height, unsigned MemorySize, class Memory>
+constexpr void
+basic_statemachine<Width, Height, MemorySize, Memory>::rehash_memory() {
+  m_memory_hash = 0;
+  for (uint32_t addr = 0; addr < MEMORY_SIZE; ++addr) {
+    m_memory_hash ^= hash_term(addr, m_mem.read(addr));
+  }
+}
+
+template <unsigned Width, unsigned Height, unsigned MemorySize, class Memory>
+constexpr void
+basic_statemachine<Width, Height, MemorySize, Memory>::rehash_display() {
+  m_display_hash = 0;
+  for (size_t idx = 0; idx < DISPLAY_SIZE; ++idx) {
+    m_display_hash ^= hash_term(MEMORY_SIZE + idx, m_display[idx]);
+  }
+}
+
+template <unsigned Width, unsigned Height, unsigned MemorySize, class Memory>
+constexpr uint64_t
+basic_statemachine<Width, Height, MemorySize, Memory>::state_hash() const {
+  uint64_t hash = m_memory_hash ^ m_display_hash;
+  uint32_t pos = MEMORY_SIZE + DISPLAY_SIZE;
+  for (uint8_t reg : m_regs) {
+    hash ^= hash_term(pos++, reg);
+  }
+  for (uint16_t value : {m_reg_I, m_pc, uint16_t{reg_DT()},
+                         uint16_t{reg_ST()}, uint16_t(m_rng),
+                         uint16_t(m_rng >> 16)}) {
+    hash ^= hash_term(pos++, value);
+  }
+  // The size is hashed so that a stack of return addresses to 0x000 is
+  // distinguishable from an empty one.
+  auto stack = m_stack.const_view();
+  hash ^= hash_term(pos++, stack.size() + 1);
+  for (uint16_t addr : stack) {
+    hash ^= hash_term(pos++, addr);
+  }
+  return hash;
+}
+
+template <unsigned Width, unsigned Height, unsigned MemorySize, class Memory>
+constexpr uint16_t
+basic_statemachine<Width, Height, MemorySize, Memory>::peek_opcode(
+    uint32_t addr) const {
+  // Never fuse across a breakpoint.
+  if (addr + 1 >= MEMORY_SIZE ||
+      (m_debug_pages[addr / DEBUG_PAGE_SIZE] & PAGE_BREAKPOINT)) {
+    return 0;
+  }
+  return m_mem.read(addr + 1) | (m_mem.read(addr) << 8);
+}
+
+template <unsigned Width, unsigned Height, unsigned MemorySize, class Memory>
+constexpr statemachine_common::status
+basic_statemachine<Width, Height, MemorySize, Memory>::draw_sprite(uint8_t x,
+                                                                   uint8_t y,
+                                                                   uint8_t n) {
+  if ((m_reg_I + n) > MEMORY_SIZE) {
+    return MEMORY_OVERFLOW;
+  }
+  uint8_t vx = m_regs.at(x);
+  uint8_t vy = m_regs.at(y);
+  m_regs[0xF] = 0;
+  uint16_t flipped = 0;
+
+  /* std::cout << "DRAW: I=" << m_reg_I << " x=" << (uint16_t)x << " y=" <<
+   * (uint16_t)y << " vx=" << (int)vx << " vy=" << (int)vy << std::endl; */
+
+  for (uint16_t mem_sprite_pos = m_reg_I, mem_sprite_end = m_reg_I + n,
+                row = vy, row_end = vy + n;
+       row < row_end; ++row, ++mem_sprite_pos) {
+    uint8_t sprite_row_contents = m_mem.read(mem_sprite_pos & ADDRESS_MASK);
+
+    // In drawing each line of the sprite, we will cross a byte-boundary if
+    // VX isn't divisible by 8. Thus, we have to flip the bits in each byte
+    // across the boundary carefully.
+
+    // To figure out which bits go where, we shift the sprite row
+    // in a uint16_t which should span both possible bytes that our
+    // shifted should now store in its upper byte the bits that will be
+    // flipped in the first byte and the bits that will be flipped in the
+    // second byte in the lower byte.
+    // For example, for vx=3, when the sprite row contents are 0x10011001,
+    // shifted should be 0b0001001100100000.
+    uint16_t shifted = static_cast<uint16_t>(sprite_row_contents) << 8;
+    shifted >>= vx & 0b111;
+
+    // Now we fill the bytes spanned by this sprite.
+    size_t row_begin = (row & ROW_MASK) * ROW_SIZE;
+    size_t first_idx = row_begin + ((vx >> 3) & ROW_OFFSET_MASK);
+    size_t last_idx = row_begin + (((vx >> 3) + 1) & ROW_OFFSET_MASK);
+
+    uint16_t display_bits =
+        (static_cast<uint16_t>(m_display[first_idx]) << 8) |
+        m_display[last_idx];
+
+    /* std::cout << "  first_idx=" << first_idx << " last_idx=" << last_idx <<
+     * "\n   shifted=" << std::bitset<16>(shifted) << "\n      mask=" <<
+     * std::bitset<16>(display_bits) << std::endl; */
+
+    m_regs[0xF] |= !!(shifted & display_bits);
+
+    display_bits ^= shifted;
+    flipped |= shifted;
+
+    write_display(first_idx, display_bits >> 8);
+    write_display(last_idx, display_bits & 0xFF);
+  }
+  m_display_generation += !!flipped;
+  return watch(m_reg_I, n, ACCESS_READ) ? WATCHPOINT : NO_ERROR;
+}
+
+template <unsigned Width, unsigned Height, unsigned MemorySize, class Memory>
+constexpr statemachine_common::status
+basic_statemachine<Width, Height, MemorySize, Memory>::store_bcd(uint8_t x) {
+  auto vx = m_regs.at(x);
+  write_memory((m_reg_I + 2) & ADDRESS_MASK, vx % 10);
+  vx /= 10;
+  write_memory((m_reg_I + 1) & ADDRESS_MASK, vx % 10);
+  vx /= 10;
+  write_memory(m_reg_I & ADDRESS_MASK, vx % 10);
+  mark_dirty(m_reg_I, 3);
+  return watch(m_reg_I, 3, ACCESS_WRITE) ? WATCHPOINT : NO_ERROR;
+}
+
+template <unsigned Width, unsigned Height, unsigned MemorySize, class Memory>
+constexpr statemachine_common::status
+basic_statemachine<Width, Height, MemorySize, Memory>::store_registers(
+    uint8_t x) {
+  uint16_t begin = m_reg_I;
+  for (unsigned i = 0; i <= x; ++i) {
+    write_memory((m_reg_I + i) & ADDRESS_MASK, m_regs.at(i));
+  }
+  mark_dirty(m_reg_I, x + 1);
+  if (!m_quirk_load_store) {
+    m_reg_I += x + 1;
+  }
+  return watch(begin, x + 1, ACCESS_WRITE) ? WATCHPOINT : NO_ERROR;
+}
+
+template <unsigned Width, unsigned Height, unsigned MemorySize, class Memory>
+constexpr statemachine_common::status
+basic_statemachine<Width, Height, MemorySize, Memory>::load_registers(
+    uint8_t x) {
+  uint16_t begin = m_reg_I;
+  for (unsigned i = 0; i <= x; ++i) {
+    m_regs[i] = m_mem.read((m_reg_I + i) & ADDRESS_MASK);
+  }
+  if (!m_quirk_load_store) {
+    m_reg_I += x + 1;
+  }
+  return watch(begin, x + 1, ACCESS_READ) ? WATCHPOINT : NO_ERROR;
+}
+
+template <unsigned Width, unsigned Height, unsigned MemorySize, class Memory>
+constexpr bool
+basic_statemachine<Width, Height, MemorySize, Memory>::breakpoint_hit()
+    const {
+  for (const auto &bp : m_breakpoints) {
+    if (bp.pc != m_pc) {
+      continue;
+    }
+    if (bp.operand == BREAK_ALWAYS ||
+        (bp.operand == BREAK_ON_I && m_reg_I == bp.value) ||
+        (bp.operand < 16 && m_regs[bp.operand] == bp.value)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <unsigned Width, unsigned Height, unsigned MemorySize, class Memory>
+constexpr bool
+basic_statemachine<Width, Height, MemorySize, Memory>::watch(
+    uint16_t addr, unsigned len, access kind) {
+  if (len == 0) {
+    return false;
+  }
+  // Accesses span at most 16 bytes, so at most two pages.
+  uint16_t first = addr & ADDRESS_MASK;
+  uint16_t last = (addr + len - 1) & ADDRESS_MASK;
+  if (!((m_debug_pages[first / DEBUG_PAGE_SIZE] |
+         m_debug_pages[last / DEBUG_PAGE_SIZE]) &
+        kind)) [[likely]] {
+    return false;
+  }
+  for (unsigned i = 0; i < len; ++i) {
+    uint16_t a = (addr + i) & ADDRESS_MASK;
+    for (const auto &wp : m_watchpoints) {
+      if ((wp.mask & kind) && a >= wp.begin && a < wp.end) {
+        m_last_watch_hit = {a, kind};
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+template <unsigned Width, unsigned Height, unsigned MemorySize, class Memory>
+constexpr void
+basic_statemachine<Width, Height, MemorySize,
+                        Memory>::update_debug_pages() {
+  m_debug_pages.fill(0);
+  for (const auto &bp : m_breakpoints) {
+    m_debug_pages[(bp.pc & ADDRESS_MASK) / DEBUG_PAGE_SIZE] |= PAGE_BREAKPOINT;
+  }
+  for (const auto &wp : m_watchpoints) {
+    uint32_t end = std::min<uint32_t>(wp.end, MEMORY_SIZE);
+    for (uint32_t page = wp.begin / DEBUG_PAGE_SIZE;
+         page * DEBUG_PAGE_SIZE < end; ++page) {
+      m_debug_pages[page] |= wp.mask;
+    }
+  }
+}
+
+template <unsigned Width, unsigned Height, unsigned MemorySize, class Memory>
+constexpr void
+basic_statemachine<Width, Height, MemorySize, Memory>::add_breakpoint(
+    breakpoint bp) {
+  m_breakpoints.push_back(bp);
+  update_debug_pages();
+}
+
+template <unsigned Width, unsigned Height, unsigned MemorySize, class Memory>
+constexpr void
+basic_statemachine<Width, Height, MemorySize, Memory>::remove_breakpoint(
+    uint16_t pc) {
+  std::erase_if(m_breakpoints,
+                [pc](const breakpoint &bp) { return bp.pc == pc; });
+  update_debug_pages();
+}
+
+template <unsigned Width, unsigned Height, unsigned MemorySize, class Memory>
+constexpr void
+basic_statemachine<Width, Height, MemorySize, Memory>::add_watchpoint(
+    watchpoint wp) {
+  m_watchpoints.push_back(wp);
+  update_debug_pages();
+}
+
+template <unsigned Width, unsigned Height, unsigned MemorySize, class Memory>
+constexpr void
+basic_statemachine<Width, Height, MemorySize,
+                        Memory>::clear_watchpoints() {
+  m_watchpoints.clear();
+  update_debug_pages();
+}
+
+template <unsigned Width, unsigned Height, unsigned MemorySize, class Memory>
+constexpr statemachine_common::status
+basic_statemachine<Width, Height, MemorySize, Memory>::step(uint16_t keystate) {
+
+  if (m_pc & 1) [[unlikely]] {
+    return PC_UNALIGNED;
+  }
+  if constexpr (MEMORY_SIZE < 0x10000) { // A 64 KiB PC can never overflow.
+    if (m_pc >= MEMORY_SIZE) [[unlikely]] {
+      return PC_OUT_OF_RANGE;
+    }
+  }
+
+  if (m_debug_pages[m_pc / DEBUG_PAGE_SIZE] & PAGE_BREAKPOINT) [[unlikely]] {
+    if (m_pc == m_resume_pc) {
+      m_resume_pc = NO_RESUME;
+    } else if (breakpoint_hit()) {
+      m_resume_pc = m_pc;
+      return BREAKPOINT;
+    }
+  }
+
+  // Opcodes are stored in most-significant-byte-first.
+  uint16_t opcode =
+      m_mem.read(m_pc | 1) | (m_mem.read(static_cast<uint16_t>(m_pc)) << 8);
+
+  if (!std::is_constant_evaluated() && SWIMP_LOG_ENABLED(log_level::trace)) {
+    trace_instruction(m_pc, opcode);
+  }
+
+  m_cycles += instruction_cost(opcode);
+
+  uint16_t nnn = opcode & 0xFFF;
+  uint16_t n = opcode & 0xF;
+  uint8_t x = (opcode >> 8) & 0xF;
+  uint8_t y = (opcode >> 4) & 0xF;
+  uint8_t kk = opcode & 0xFF;
+
+  // Grab first hexadigit.
+  switch (opcode >> 12) {
+  case 0x0: {
+    if (opcode == 0x00E0) {
+      std::fill(m_display.begin(), m_display.end(), 0);
+      m_display_hash = 0;
+      ++m_display_generation;
+    } else if (opcode == 0x00EE) {
+      if (m_stack.empty()) [[unlikely]] {
+        return POPPED_EMPTY_STACK;
+      }
+      m_pc = m_stack.top();
+      m_stack.pop();
+      return NO_ERROR;
+    } else if (DISPLAY_WIDTH > 64 && (opcode & 0xFFF0) == 0x00C0) {
+      scroll_down(n);
+      ++m_display_generation;
+    } else if (DISPLAY_WIDTH > 64 && opcode == 0x00FB) {
+      scroll_horizontal(4);
+      ++m_display_generation;
+    } else if (DISPLAY_WIDTH > 64 && opcode == 0x00FC) {
+      scroll_horizontal(-4);
+      ++m_display_generation;
+    } else {
+      // Ignore SYS
+    }
+  } break;
+
+  case 0x1: {
+    m_pc = nnn;
+    return NO_ERROR;
+  } break;
+
+  case 0x2: {
+    if (m_stack.size() == STACK_SIZE) [[unlikely]] {
+      return PUSHED_FULL_STACK;
+    } else {
+      m_stack.push(m_pc + 2);
+      m_pc = nnn;
+      return NO_ERROR;
+    }
+  }
+
+  case 0x3: {
+    if (m_regs.at(x) == kk) {
+      m_pc += 4;
+      return NO_ERROR;
+    }
+  } break;
+
+  case 0x4: {
+    if (m_regs.at(x) != kk) {
+      m_pc += 4;
+      return NO_ERROR;
+    }
+  } break;
+
+  case 0x5: {
+    if (m_regs.at(x) == m_regs.at(y)) {
+      m_pc += 4;
+      return NO_ERROR;
+    }
+  } break;
+
+  case 0x6: {
+    m_regs[x] = kk;
+  } break;
+
+  case 0x7: {
+    m_regs[x] += kk;
+    // Counting loop: 7xkk; 3ykk/4ykk; 1nnn.
+    if (m_fuse_instructions) {
+      uint16_t test = peek_opcode(m_pc + 2);
+      uint16_t jump = peek_opcode(m_pc + 4);
+      if ((test >> 12 == 0x3 || test >> 12 == 0x4) && jump >> 12 == 0x1) {
+        bool equal = m_regs.at((test >> 8) & 0xF) == (test & 0xFF);
+        m_cycles += instruction_cost(test);
+        if (equal == (test >> 12 == 0x3)) {
+          m_pc += 6;
+        } else {
+          m_cycles += instruction_cost(jump);
+          m_pc = jump & 0xFFF;
+        }
+        return NO_ERROR;
+      }
+    }
+  } break;
+
+  case 0x8: {
+    switch (opcode & 0xF) {
+    case 0x0: {
+      m_regs[x] = m_regs.at(y);
+    } break;
+
+    case 0x1: {
+      m_regs[x] |= m_regs.at(y);
+    } break;
+
+    case 0x2: {
+      m_regs[x] &= m_regs.at(y);
+    } break;
+
+    case 0x3: {
+      m_regs[x] ^= m_regs.at(y);
+    } break;
+
+    case 0x4: {
+      // Octo spec (see octo/examples/test/testquirks)
+      // expects carry flag to be written last.
+      uint16_t sum = static_cast<uint16_t>(m_regs.at(x)) +
+                     static_cast<uint16_t>(m_regs.at(y));
+      m_regs[x] = sum;
+      m_regs[0xF] = (sum > 0xFF) ? 1 : 0;
+    } break;
+
+    case 0x5: {
+      bool not_borrow = m_regs.at(x) >= m_regs.at(y);
+      m_regs[x] -= m_regs.at(y);
+      m_regs[0xF] = not_borrow; // As octo does.
+    } break;
+
+    case 0x6: {
+      auto src_idx = m_quirk_shift ? x : y;
+      auto vsrc = m_regs.at(src_idx);
+
+      m_regs[x] = vsrc >> 1u;
+      m_regs[0xF] = vsrc & 1;
+    } break;
+
+    case 0x7: {
+      bool not_borrow = m_regs.at(y) >= m_regs.at(x);
+
+      m_regs[x] = m_regs.at(y) - m_regs.at(x);
+      m_regs[0xF] = not_borrow;
+    } break;
+
+    case 0xE: {
+      auto src_idx = m_quirk_shift ? x : y;
+      auto vsrc = m_regs.at(src_idx);
+
+      m_regs[x] = vsrc << 1u;
+      m_regs[0xF] = vsrc >> 7u;
+    } break;
+
+    default:
+      return NOT_IMPLEMENTED;
+    }
+    break;
+  } break;
+
+  case 0x9: {
+    if (m_regs.at(x) != m_regs.at(y)) {
+      m_pc += 4;
+      return NO_ERROR;
+    }
+  } break;
+
+  case 0xA: {
+    m_reg_I = nnn;
+    // Annn; Dxyn.
+    if (m_fuse_instructions) {
+      uint16_t next = peek_opcode(m_pc + 2);
+      if (next >> 12 == 0xD) {
+        m_pc += 2;
+        m_cycles += instruction_cost(next);
+        auto status = draw_sprite((next >> 8) & 0xF, (next >> 4) & 0xF,
+                                  next & 0xF);
+        if (status != NO_ERROR) [[unlikely]] {
+          m_pc += (status == WATCHPOINT) ? 2 : 0;
+          return status;
+        }
+      }
+    }
+  } break;
+
+  case 0xB: {
+    m_pc = nnn + m_regs.at(0);
+    return NO_ERROR;
+  } break;
+
+  case 0xC: {
+    // xorshift32: each machine has its own reproducible sequence.
+    m_rng ^= m_rng << 13;
+    m_rng ^= m_rng >> 17;
+    m_rng ^= m_rng << 5;
+    m_regs[x] = (m_rng >> 24) & kk;
+    break;
+  }
+  case 0xD: {
+    auto status = draw_sprite(x, y, n);
+    if (status != NO_ERROR) [[unlikely]] {
+      m_pc += (status == WATCHPOINT) ? 2 : 0;
+      return status;
+    }
+  } break;
+
+  case 0xE:
+    switch (kk) {
+    case 0x9E: {
+      // Values past 0xF name no key, so they are never pressed.
+      if (m_regs.at(x) < 16 && ((keystate >> m_regs.at(x)) & 1)) {
+        m_pc += 4;
+        return NO_ERROR;
+      }
+    } break;
+    case 0xA1: {
+      if (m_regs.at(x) >= 16 || !((keystate >> m_regs.at(x)) & 1)) {
+        m_pc += 4;
+        return NO_ERROR;
+      }
+    } break;
+    default: {
+      return NOT_IMPLEMENTED;
+    }
+    }
+    break;
+
+  case 0xF:
+    switch (kk) {
+    case 0x07: {
+      m_regs[x] = reg_DT();
+    } break;
+
+    case 0x0A: {
+      if (keystate) {
+        for (unsigned i = 0, mask = 1; i < 16; ++i, mask <<= 1) {
+          if (mask & keystate) {
+            m_regs[x] = i;
+            break;
+          }
+        }
+      } else {
+        // Returning early means that PC isn't incremented
+        return WAITING_FOR_KEYPRESS;
+      }
+    } break;
+
+    case 0x15: {
+      m_reg_DT = m_regs.at(x);
+      m_DT_tick = ticks();
+    } break;
+
+    case 0x18: {
+      m_reg_ST = m_regs.at(x);
+      m_ST_tick = ticks();
+    } break;
+
+    case 0x1E: {
+      m_reg_I += m_regs.at(x);
+    } break;
+
+    case 0x29: {
+      m_reg_I = m_font_begin + (m_regs.at(x) * FONT_SPRITE_SIZE);
+      // Fx29; Dxyn.
+      if (m_fuse_instructions) {
+        uint16_t next = peek_opcode(m_pc + 2);
+        if (next >> 12 == 0xD) {
+          m_pc += 2;
+          m_cycles += instruction_cost(next);
+          auto status = draw_sprite((next >> 8) & 0xF, (next >> 4) & 0xF,
+                                    next & 0xF);
+          if (status != NO_ERROR) [[unlikely]] {
+            m_pc += (status == WATCHPOINT) ? 2 : 0;
+            return status;
+          }
+        }
+      }
+    } break;
+
+    case 0x33: {
+      auto status = store_bcd(x);
+      // Fx33; Fx65.
+      if (status == NO_ERROR && m_fuse_instructions) {
+        uint16_t next = peek_opcode(m_pc + 2);
+        if ((next & 0xF0FF) == 0xF065) {
+          m_pc += 2;
+          m_cycles += instruction_cost(next);
+          status = load_registers((next >> 8) & 0xF);
+        }
+      }
+      if (status != NO_ERROR) [[unlikely]] {
+        m_pc += 2;
+        return status;
+      }
+    } break;
+
+    case 0x55: {
+      if (store_registers(x) != NO_ERROR) [[unlikely]] {
+        m_pc += 2;
+        return WATCHPOINT;
+      }
+    } break;
+
+    case 0x65: {
+      if (load_registers(x) != NO_ERROR) [[unlikely]] {
+        m_pc += 2;
+        return WATCHPOINT;
+      }
+    } break;
+    default:
+      return NOT_IMPLEMENTED;
+    }
+    break;
+  }
+
+  m_pc += 2;
+  return NO_ERROR;
+}
+
+extern template class basic_statemachine<64, 32, 0x1000>;
+extern template class basic_statemachine<128, 64, 0x1000>;
+extern template class basic_statemachine<128, 64, 0x10000>;
+extern template class basic_statemachine<64, 32, 0x1000, cow_memory<0x1000>>;
+
 #endif // SWIMP_STATEMACHINE_H
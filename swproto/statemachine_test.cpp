@@ -4,7 +4,9 @@
 #include <gtest/gtest.h>
 #include <initializer_list>
 #include <sstream>
+#include <thread>
 
+#include "boot.hpp"
 #include "font.hpp"
 #include "statemachine.hpp"
 
@@ -52,13 +54,14 @@ std::string mem_of(const statemachine &mach) {
 
 bool is_zero(uint8_t x) { return x == 0; }
 
+template <class Machine>
 inline void
-ASSERT_STEP(statemachine &mach, uint16_t keystate, bool tick,
+ASSERT_STEP(Machine &mach, uint16_t keystate,
             statemachine::status expected_status = statemachine::NO_ERROR) {
   using namespace std;
 
   auto next_instruction = mach.curr_instruction();
-  auto resultant_status = mach.step(keystate, tick);
+  auto resultant_status = mach.step(keystate);
 
   ASSERT_EQ(resultant_status, expected_status)
       << "while executing opcode 0x" << hex << setfill('0') << setw(4)
@@ -75,13 +78,13 @@ TEST(StateMachineTest, Test00EE_2nnn) {
   };
 
   statemachine machine(instructions);
-  ASSERT_STEP(machine, 0, 0);
+  ASSERT_STEP(machine, 0);
   ASSERT_EQ(machine.pc(), 0x004);
-  ASSERT_STEP(machine, 0, 0);
+  ASSERT_STEP(machine, 0);
   ASSERT_EQ(machine.pc(), 0x008);
-  ASSERT_STEP(machine, 0, 0);
+  ASSERT_STEP(machine, 0);
   ASSERT_EQ(machine.pc(), 0x006);
-  ASSERT_STEP(machine, 0, 0);
+  ASSERT_STEP(machine, 0);
   ASSERT_EQ(machine.pc(), 0x002);
 }
 
@@ -92,11 +95,11 @@ TEST(StateMachineTest, Test6xkk_7xkk) {
       0x77FF  // ADD V7, 0x77
   });
   EXPECT_EQ(machine.regs()[0x7], 0);
-  ASSERT_STEP(machine, 0, false);
+  ASSERT_STEP(machine, 0);
   EXPECT_EQ(machine.regs()[0x7], 0x89);
-  ASSERT_STEP(machine, 0, false);
+  ASSERT_STEP(machine, 0);
   EXPECT_EQ(machine.regs()[0x7], 0x99);
-  ASSERT_STEP(machine, 0, false);
+  ASSERT_STEP(machine, 0);
   EXPECT_EQ(machine.regs()[0x7], 0x98);
 }
 
@@ -123,7 +126,7 @@ TEST(StateMachineTest, Test1nnn) {
 
   // Make sure we never execute LD V6, 0x66
   for (int i = 0; i < 100; ++i) {
-    ASSERT_STEP(machine, 0, false);
+    ASSERT_STEP(machine, 0);
     ASSERT_EQ(machine.regs()[0x6], 0);
   }
 
@@ -147,7 +150,7 @@ TEST(StateMachineTest, Test3xkk_4xkk) {
   statemachine machine(instructions);
 
   for (unsigned i = 0; i < 6 /* 2 of 8 instructions should be skipped */; ++i) {
-    ASSERT_STEP(machine, 0, false);
+    ASSERT_STEP(machine, 0);
   }
 
   ASSERT_EQ(machine.pc(), instructions.size() * 2)
@@ -184,7 +187,7 @@ TEST(StateMachineTest, Test5xy0_9xy0) {
   // Run until complete
   unsigned i;
   for (i = 0; (i < 20) && (machine.memory()[machine.pc()] != 0); ++i) {
-    ASSERT_STEP(machine, 0, false);
+    ASSERT_STEP(machine, 0);
   }
 
   ASSERT_NE(i, 20); // Make sure we didn't go somewhere we're not meant to be.
@@ -203,8 +206,8 @@ TEST(StateMachineTest, Test8xy0) {
   };
   statemachine machine(instructions);
 
-  ASSERT_STEP(machine, 0, false);
-  ASSERT_STEP(machine, 0, false);
+  ASSERT_STEP(machine, 0);
+  ASSERT_STEP(machine, 0);
 
   ASSERT_EQ(machine.regs()[0x0], 0x00); // V0 should never have been set.
   ASSERT_EQ(machine.regs()[0x1], 0x44); // V1 should be 0x44
@@ -239,7 +242,7 @@ TEST(StateMachineTest, Test8xy1_7xy2_8xy3) {
   statemachine machine(instructions);
 
   for (unsigned i = 0; i < instructions.size(); ++i) {
-    ASSERT_STEP(machine, 0, false);
+    ASSERT_STEP(machine, 0);
   }
 
   // Check if VA-VF have intended values.
@@ -261,7 +264,7 @@ TEST(StateMachineTest, Test8xy4) {
   });
 
   for (int i = 0; i < 5; ++i) {
-    ASSERT_STEP(machine, 0, false);
+    ASSERT_STEP(machine, 0);
   }
 
   ASSERT_EQ(machine.regs()[0x0], 0x04); // 0x82 + 0x82 = 0x104
@@ -283,7 +286,7 @@ TEST(StateMachineTest, Test8xy5) {
   });
 
   for (int i = 0; i < 8; ++i) {
-    ASSERT_STEP(machine, 0, false);
+    ASSERT_STEP(machine, 0);
   }
 
   ASSERT_EQ(machine.regs()[0xA], 0x90); // 0x92 - 0x02 = 0x90
@@ -305,17 +308,17 @@ TEST(StateMachineTest, Test8xy6) {
 
     { // Case with shift quirks.
       statemachine machine(instructions, {.quirk_shift = true});
-      ASSERT_STEP(machine, 0, false);
-      ASSERT_STEP(machine, 0, false);
-      ASSERT_STEP(machine, 0, false);
+      ASSERT_STEP(machine, 0);
+      ASSERT_STEP(machine, 0);
+      ASSERT_STEP(machine, 0);
       ASSERT_EQ(machine.regs()[0x0], 0x41);
       ASSERT_EQ(machine.regs()[0xF], 0);
     }
     { // Case without shift quirks.
       statemachine machine(instructions, {.quirk_shift = false});
-      ASSERT_STEP(machine, 0, false);
-      ASSERT_STEP(machine, 0, false);
-      ASSERT_STEP(machine, 0, false);
+      ASSERT_STEP(machine, 0);
+      ASSERT_STEP(machine, 0);
+      ASSERT_STEP(machine, 0);
       ASSERT_EQ(machine.regs()[0x0], 0x42);
       ASSERT_EQ(machine.regs()[0xF], 0);
     }
@@ -329,17 +332,17 @@ TEST(StateMachineTest, Test8xy6) {
 
     { // Case with shift quirks.
       statemachine machine(instructions, {.quirk_shift = true});
-      ASSERT_STEP(machine, 0, false);
-      ASSERT_STEP(machine, 0, false);
-      ASSERT_STEP(machine, 0, false);
+      ASSERT_STEP(machine, 0);
+      ASSERT_STEP(machine, 0);
+      ASSERT_STEP(machine, 0);
       ASSERT_EQ(machine.regs()[0x0], 0x41);
       ASSERT_EQ(machine.regs()[0xF], 1);
     }
     { // Case without shift quirks.
       statemachine machine(instructions, {.quirk_shift = false});
-      ASSERT_STEP(machine, 0, false);
-      ASSERT_STEP(machine, 0, false);
-      ASSERT_STEP(machine, 0, false);
+      ASSERT_STEP(machine, 0);
+      ASSERT_STEP(machine, 0);
+      ASSERT_STEP(machine, 0);
       ASSERT_EQ(machine.regs()[0x0], 0x42);
       ASSERT_EQ(machine.regs()[0xF], 1);
     }
@@ -361,7 +364,7 @@ TEST(StateMachineTest, Test8xy7) {
   statemachine machine(instructions);
 
   for (unsigned i = 0; i < instructions.size(); ++i) {
-    ASSERT_STEP(machine, 0, false);
+    ASSERT_STEP(machine, 0);
   }
 
   ASSERT_EQ(machine.regs()[0xA], 0x70); // 0x02 - 0x92 = 0x70
@@ -380,17 +383,17 @@ TEST(StateMachineTest, Test8xyE) {
 
     { // Case with shift quirks.
       statemachine machine(instructions, {.quirk_shift = true});
-      ASSERT_STEP(machine, 0, false);
-      ASSERT_STEP(machine, 0, false);
-      ASSERT_STEP(machine, 0, false);
+      ASSERT_STEP(machine, 0);
+      ASSERT_STEP(machine, 0);
+      ASSERT_STEP(machine, 0);
       ASSERT_EQ(machine.regs()[0x0], 10);
       ASSERT_EQ(machine.regs()[0xF], 0);
     }
     { // Case without shift quirks.
       statemachine machine(instructions, {.quirk_shift = false});
-      ASSERT_STEP(machine, 0, false);
-      ASSERT_STEP(machine, 0, false);
-      ASSERT_STEP(machine, 0, false);
+      ASSERT_STEP(machine, 0);
+      ASSERT_STEP(machine, 0);
+      ASSERT_STEP(machine, 0);
       ASSERT_EQ(machine.regs()[0x0], 14);
       ASSERT_EQ(machine.regs()[0xF], 0);
     }
@@ -404,17 +407,17 @@ TEST(StateMachineTest, Test8xyE) {
 
     { // Case with shift quirks.
       statemachine machine(instructions, {.quirk_shift = true});
-      ASSERT_STEP(machine, 0, false);
-      ASSERT_STEP(machine, 0, false);
-      ASSERT_STEP(machine, 0, false);
+      ASSERT_STEP(machine, 0);
+      ASSERT_STEP(machine, 0);
+      ASSERT_STEP(machine, 0);
       ASSERT_EQ(machine.regs()[0x0], 10);
       ASSERT_EQ(machine.regs()[0xF], 1);
     }
     { // Case without shift quirks.
       statemachine machine(instructions, {.quirk_shift = false});
-      ASSERT_STEP(machine, 0, false);
-      ASSERT_STEP(machine, 0, false);
-      ASSERT_STEP(machine, 0, false);
+      ASSERT_STEP(machine, 0);
+      ASSERT_STEP(machine, 0);
+      ASSERT_STEP(machine, 0);
       ASSERT_EQ(machine.regs()[0x0], 14);
       ASSERT_EQ(machine.regs()[0xF], 1);
     }
@@ -432,17 +435,17 @@ TEST(StateMachineTest, TestEx9E) {
 
     { // Should skip b/c exact match.
       statemachine machine(instructions);
-      ASSERT_STEP(machine, 0, false);
-      ASSERT_STEP(machine, 1u << 9u, false);
-      ASSERT_STEP(machine, 0, false);
+      ASSERT_STEP(machine, 0);
+      ASSERT_STEP(machine, 1u << 9u);
+      ASSERT_STEP(machine, 0);
       ASSERT_EQ(machine.regs()[0], 0x00);
     }
 
     { // Should not skip because does not match.
       statemachine machine(instructions);
-      ASSERT_STEP(machine, 0, false);
-      ASSERT_STEP(machine, 1u << 2u, false);
-      ASSERT_STEP(machine, 0, false);
+      ASSERT_STEP(machine, 0);
+      ASSERT_STEP(machine, 1u << 2u);
+      ASSERT_STEP(machine, 0);
       ASSERT_EQ(machine.regs()[0], 0xFF);
     }
   }
@@ -455,9 +458,9 @@ TEST(StateMachineTest, TestEx9E) {
     };
     // Should not because 0x77 is not a real key and thus is never pressed.
     statemachine machine(instructions);
-    ASSERT_STEP(machine, 0, false);
-    ASSERT_STEP(machine, 0xFFFF /* Press all available keys */, false);
-    ASSERT_STEP(machine, 0, false);
+    ASSERT_STEP(machine, 0);
+    ASSERT_STEP(machine, 0xFFFF /* Press all available keys */);
+    ASSERT_STEP(machine, 0);
     ASSERT_EQ(machine.regs()[0], 0xFF);
   }
 }
@@ -473,17 +476,17 @@ TEST(StateMachineTest, TestExA1) {
 
     { // Should not skip b/c exact match.
       statemachine machine(instructions);
-      ASSERT_STEP(machine, 0, false);
-      ASSERT_STEP(machine, 1u << 9u, false);
-      ASSERT_STEP(machine, 0, false);
+      ASSERT_STEP(machine, 0);
+      ASSERT_STEP(machine, 1u << 9u);
+      ASSERT_STEP(machine, 0);
       ASSERT_EQ(machine.regs()[0], 0xFF);
     }
 
     { // Should skip because does not match.
       statemachine machine(instructions);
-      ASSERT_STEP(machine, 0, false);
-      ASSERT_STEP(machine, 1u << 2u, false);
-      ASSERT_STEP(machine, 0, false);
+      ASSERT_STEP(machine, 0);
+      ASSERT_STEP(machine, 1u << 2u);
+      ASSERT_STEP(machine, 0);
       ASSERT_EQ(machine.regs()[0], 0x00);
     }
   }
@@ -497,9 +500,9 @@ TEST(StateMachineTest, TestExA1) {
         0x0000, // NOOP
     };
     statemachine machine(instructions);
-    ASSERT_STEP(machine, 0, false);
-    ASSERT_STEP(machine, 0xFFFF, false);
-    ASSERT_STEP(machine, 0, false);
+    ASSERT_STEP(machine, 0);
+    ASSERT_STEP(machine, 0xFFFF);
+    ASSERT_STEP(machine, 0);
     ASSERT_EQ(machine.regs()[0], 0x00);
   }
 }
@@ -514,13 +517,13 @@ TEST(StateMachineTest, TestAnnn_Fx1E) {
   };
   statemachine machine(instructions);
 
-  ASSERT_STEP(machine, 0, false);
+  ASSERT_STEP(machine, 0);
   ASSERT_EQ(machine.reg_I(), 0xF10);
-  ASSERT_STEP(machine, 0, false);
-  ASSERT_STEP(machine, 0, false);
+  ASSERT_STEP(machine, 0);
+  ASSERT_STEP(machine, 0);
   ASSERT_EQ(machine.reg_I(), 0xFF0);
-  ASSERT_STEP(machine, 0, false);
-  ASSERT_STEP(machine, 0, false);
+  ASSERT_STEP(machine, 0);
+  ASSERT_STEP(machine, 0);
   ASSERT_EQ(machine.reg_I(), 0x0D0);
 }
 
@@ -533,11 +536,11 @@ TEST(StateMachineTest, TestFx0A) {
 
   // Spin a bit, making sure that the PC doesn't progress.
   for (unsigned i = 0; i < 100; ++i) {
-    ASSERT_STEP(machine, 0, false, statemachine::WAITING_FOR_KEYPRESS);
+    ASSERT_STEP(machine, 0, statemachine::WAITING_FOR_KEYPRESS);
     ASSERT_EQ(machine.pc(), 0) << "Machine should not progress.";
   }
   // Press key 7.
-  ASSERT_STEP(machine, 1u << 7u, false);
+  ASSERT_STEP(machine, 1u << 7u);
   ASSERT_EQ(machine.pc(), 0x02) << "Machine should progress.";
   ASSERT_EQ(machine.regs()[0], 7);
 }
@@ -551,10 +554,10 @@ TEST(StateMachineTest, TestFx29) {
   };
   statemachine machine(instructions, {.font_begin = test_font_begin});
 
-  ASSERT_STEP(machine, 0, false);
+  ASSERT_STEP(machine, 0);
   ASSERT_EQ(machine.reg_I(), test_font_begin);
-  ASSERT_STEP(machine, 0, false);
-  ASSERT_STEP(machine, 0, false);
+  ASSERT_STEP(machine, 0);
+  ASSERT_STEP(machine, 0);
   ASSERT_EQ(machine.reg_I(), test_font_begin + (4 * FONT_SPRITE_SIZE));
 }
 
@@ -564,29 +567,40 @@ TEST(StateMachineTest, TestFx15_Fx18_Timers) {
       0x6102, // LD V1, 0x02
       0xF015, // LD DT, V0
       0xF118, // LD ST, V1
+      0x0000, // NO-OP
+      0x0000, // NO-OP
+      0xF207, // LD V2, DT
 
-      0x0000, 0x0000, 0x0000, 0x0000 /* NO-OPs */
+      0x0000, 0x0000, 0x0000 /* NO-OPs */
   };
-  statemachine machine(instructions);
+  // Ticks land on cycles 1, 3, 5, 7, ...
+  statemachine machine(instructions, {.cycles_per_tick = 2});
 
   // Make sure the values are loaded.
-  ASSERT_STEP(machine, 0, false);
-  ASSERT_STEP(machine, 0, false);
-  ASSERT_STEP(machine, 0, false);
-  ASSERT_STEP(machine, 0, false);
+  ASSERT_STEP(machine, 0);
+  ASSERT_STEP(machine, 0);
+  ASSERT_STEP(machine, 0);
+  ASSERT_STEP(machine, 0);
   ASSERT_EQ(machine.reg_DT(), 0x03);
   ASSERT_EQ(machine.reg_ST(), 0x02);
 
   // Make sure clock ticks to, but not past, 0.
-  ASSERT_STEP(machine, 0, true);
+  ASSERT_STEP(machine, 0);
+  ASSERT_EQ(machine.reg_DT(), 0x02);
+  ASSERT_EQ(machine.reg_ST(), 0x01);
+  ASSERT_STEP(machine, 0);
   ASSERT_EQ(machine.reg_DT(), 0x02);
   ASSERT_EQ(machine.reg_ST(), 0x01);
-  ASSERT_STEP(machine, 0, true);
+  ASSERT_STEP(machine, 0); // Executes LD V2, DT
+  ASSERT_EQ(machine.regs()[2], 0x01);
   ASSERT_EQ(machine.reg_DT(), 0x01);
   ASSERT_EQ(machine.reg_ST(), 0x00);
-  ASSERT_STEP(machine, 0, true);
+  ASSERT_STEP(machine, 0);
+  ASSERT_STEP(machine, 0);
   ASSERT_EQ(machine.reg_DT(), 0x00);
   ASSERT_EQ(machine.reg_ST(), 0x00);
+  ASSERT_STEP(machine, 0);
+  ASSERT_EQ(machine.reg_DT(), 0x00);
 }
 
 TEST(StateMachineTest, TestFx33) {
@@ -597,9 +611,9 @@ TEST(StateMachineTest, TestFx33) {
   };
   statemachine machine(instructions);
 
-  ASSERT_STEP(machine, 0, false);
-  ASSERT_STEP(machine, 0, false);
-  ASSERT_STEP(machine, 0, false);
+  ASSERT_STEP(machine, 0);
+  ASSERT_STEP(machine, 0);
+  ASSERT_STEP(machine, 0);
 
   ASSERT_EQ(machine.memory()[machine.reg_I()], 1);
   ASSERT_EQ(machine.memory()[machine.reg_I() + 1], 2);
@@ -623,7 +637,7 @@ TEST(StateMachineTest, TestFx55) {
 
     // Execute first 16 ops (that fill up V0..VF with randomness).
     for (unsigned i = 0; i < 16; ++i) {
-      ASSERT_STEP(machine, 0, false);
+      ASSERT_STEP(machine, 0);
     }
 
     std::array<uint8_t, 16> random_bytes;
@@ -632,8 +646,8 @@ TEST(StateMachineTest, TestFx55) {
     auto mem = machine.memory();
     auto mem_random_begin = mem.begin() + 0xE00;
 
-    ASSERT_STEP(machine, 0, false); // Executes LD I, 0xE00
-    ASSERT_STEP(machine, 0, false); // Executes LD [I], V7
+    ASSERT_STEP(machine, 0); // Executes LD I, 0xE00
+    ASSERT_STEP(machine, 0); // Executes LD [I], V7
 
     if (quirk_load_store) {
       ASSERT_EQ(machine.reg_I(), 0xE00);
@@ -649,8 +663,8 @@ TEST(StateMachineTest, TestFx55) {
     ASSERT_TRUE(std::all_of(mem_random_begin + 8, mem.end(), is_zero))
         << mem_of(machine);
 
-    ASSERT_STEP(machine, 0, false); // Executes LD I, 0xE00
-    ASSERT_STEP(machine, 0, false); // Executes LD [I], VF
+    ASSERT_STEP(machine, 0); // Executes LD I, 0xE00
+    ASSERT_STEP(machine, 0); // Executes LD [I], VF
 
     // Make sure that V0..VF matches mem[0xE00]..mem[0xE0F].
     ASSERT_TRUE(
@@ -680,8 +694,8 @@ TEST(StateMachineTest, TestFx65) {
     statemachine machine(instructions,
                          {.quirk_load_store = !!quirk_load_store});
 
-    ASSERT_STEP(machine, 0, false); // Executes LD I, 0x006
-    ASSERT_STEP(machine, 0, false); // Executes LD V7, [0x006]
+    ASSERT_STEP(machine, 0); // Executes LD I, 0x006
+    ASSERT_STEP(machine, 0); // Executes LD V7, [0x006]
 
     if (quirk_load_store) {
       ASSERT_EQ(machine.reg_I(), 0x008);
@@ -699,8 +713,8 @@ TEST(StateMachineTest, TestFx65) {
           << regs_of(machine);
     }
 
-    ASSERT_STEP(machine, 0, false); // Executes LD I, 0x006
-    ASSERT_STEP(machine, 0, false); // Executes LD VF, [0x006]
+    ASSERT_STEP(machine, 0); // Executes LD I, 0x006
+    ASSERT_STEP(machine, 0); // Executes LD VF, [0x006]
     {
       // Make sure all the regs are the same nonsense.
       std::array<uint8_t, 16> expected_regs{0xDE, 0xAD, 0xBE, 0xEF, 0xF0, 0x0D,
@@ -723,7 +737,7 @@ TEST(StateMachineTest, TestCxkk) {
   statemachine machine(instructions);
 
   for (unsigned i = 0; i < instructions.size(); ++i) {
-    ASSERT_STEP(machine, 0, false);
+    ASSERT_STEP(machine, 0);
     // Check mask.
     ASSERT_EQ(machine.regs()[i] & ~0xDB, 0x00);
   }
@@ -754,7 +768,7 @@ TEST(StateMachineTest, Test00E0_Dxyn) {
   }
 
   {
-    ASSERT_STEP(machine, 0, 0); // Executes DRW V0, V1, 1
+    ASSERT_STEP(machine, 0); // Executes DRW V0, V1, 1
     auto display = machine.display();
     std::array<uint8_t, statemachine::DISPLAY_SIZE> expected_display{0x0F};
     ASSERT_TRUE(
@@ -763,14 +777,14 @@ TEST(StateMachineTest, Test00E0_Dxyn) {
     ASSERT_FALSE(machine.regs()[0xF]);
   }
   {
-    ASSERT_STEP(machine, 0, 0); // Executes DRW V0, V1, 1
+    ASSERT_STEP(machine, 0); // Executes DRW V0, V1, 1
     auto display = machine.display();
     ASSERT_TRUE(std::all_of(display.begin(), display.end(), is_zero));
     ASSERT_TRUE(machine.regs()[0xF]);
   }
   {
-    ASSERT_STEP(machine, 0, 0); // Executes LD V0, 0x02
-    ASSERT_STEP(machine, 0, 0); // Executes DRW V0, V1, 1
+    ASSERT_STEP(machine, 0); // Executes LD V0, 0x02
+    ASSERT_STEP(machine, 0); // Executes DRW V0, V1, 1
     auto display = machine.display();
     std::array<uint8_t, statemachine::DISPLAY_SIZE> expected_display{
         0b00000011, 0b11000000};
@@ -780,13 +794,409 @@ TEST(StateMachineTest, Test00E0_Dxyn) {
     ASSERT_FALSE(machine.regs()[0xf]);
   }
   {
-    ASSERT_STEP(machine, 0, 0); // Executes CLS
+    ASSERT_STEP(machine, 0); // Executes CLS
     auto display = machine.display();
     ASSERT_TRUE(std::all_of(display.begin(), display.end(), is_zero));
   }
   {
-    ASSERT_STEP(machine, 0, 0); // Executes LDs.
+    ASSERT_STEP(machine, 0); // Executes LDs.
     auto display = machine.display();
     ASSERT_TRUE(std::all_of(display.begin(), display.end(), is_zero));
   }
 }
+
+TEST(StateMachineTest, TestCycles_DisplayGeneration) {
+  std::initializer_list<uint16_t> instructions = {
+      0xA00A, // LD I, 0x00A
+      0xD011, // DRW V0, V1, 1 (draws 0xF0, changes display)
+      0xA00C, // LD I, 0x00C
+      0xD011, // DRW V0, V1, 1 (draws 0x00, leaves display alone)
+      0x00E0, // CLS
+      0xF000, // Sprite data
+      0x0000, // Sprite data
+  };
+  statemachine machine(instructions);
+  ASSERT_EQ(machine.cycles(), 0);
+  ASSERT_EQ(machine.display_generation(), 0);
+
+  ASSERT_STEP(machine, 0);
+  ASSERT_STEP(machine, 0);
+  ASSERT_EQ(machine.display_generation(), 1);
+  ASSERT_STEP(machine, 0);
+  ASSERT_STEP(machine, 0);
+  ASSERT_EQ(machine.display_generation(), 1);
+  ASSERT_STEP(machine, 0);
+  ASSERT_EQ(machine.display_generation(), 2);
+  ASSERT_EQ(machine.cycles(), 5);
+}
+
+TEST(StateMachineTest, TestSchip00Cn_00FB_00FC) {
+  std::initializer_list<uint16_t> instructions = {
+      0x603C, // LD V0, 60
+      0x6100, // LD V1, 0
+      0xA00E, // LD I, 0x00E
+      0xD011, // DRW V0, V1, 1 (straddles the first two 64-bit words)
+      0x00FB, // SCR (right 4)
+      0x00C2, // SCD 2
+      0x00FC, // SCL (left 4)
+      0xFF00, // Sprite data
+  };
+  schip_statemachine machine(instructions);
+  const unsigned row_size = schip_statemachine::ROW_SIZE;
+
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_STEP(machine, 0);
+  }
+  ASSERT_EQ(machine.display()[7], 0x0F);
+  ASSERT_EQ(machine.display()[8], 0xF0);
+
+  ASSERT_STEP(machine, 0); // Executes SCR
+  ASSERT_EQ(machine.display()[7], 0x00);
+  ASSERT_EQ(machine.display()[8], 0xFF);
+
+  ASSERT_STEP(machine, 0); // Executes SCD 2
+  ASSERT_EQ(machine.display()[8], 0x00);
+  ASSERT_EQ(machine.display()[2 * row_size + 8], 0xFF);
+
+  ASSERT_STEP(machine, 0); // Executes SCL
+  ASSERT_EQ(machine.display()[2 * row_size + 7], 0x0F);
+  ASSERT_EQ(machine.display()[2 * row_size + 8], 0xF0);
+  auto display = machine.display();
+  ASSERT_EQ(std::count_if(display.begin(), display.end(), is_zero),
+            schip_statemachine::DISPLAY_SIZE - 2);
+
+  // The classic machine treats the scroll instructions as SYS.
+  statemachine classic({0x00FB, 0x00FC, 0x00C1});
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_STEP(classic, 0);
+  }
+  ASSERT_EQ(classic.display_generation(), 0);
+}
+
+TEST(StateMachineTest, TestXochipMemory) {
+  std::initializer_list<uint16_t> instructions = {
+      0xAFFF,        // LD I, 0xFFF
+      0x60FF,        // LD V0, 0xFF
+      0xF01E,        // ADD I, V0
+      0x6000 | 123u, // LD V0, 123
+      0xF033,        // LD B, V0 (lands past the classic 4 KiB)
+  };
+  xochip_statemachine machine(instructions);
+  for (int i = 0; i < 5; ++i) {
+    ASSERT_STEP(machine, 0);
+  }
+  ASSERT_EQ(machine.reg_I(), 0x10FE);
+  ASSERT_EQ(machine.memory()[0x10FE], 1);
+  ASSERT_EQ(machine.memory()[0x10FF], 2);
+  ASSERT_EQ(machine.memory()[0x1100], 3);
+}
+
+TEST(StateMachineTest, TestCopyOnWriteMemory) {
+  auto rom = std::make_shared<const rom_image<cow_statemachine::MEMORY_SIZE>>(
+      rom_image<cow_statemachine::MEMORY_SIZE>{
+          0xAE, 0x00, // LD I, 0xE00
+          0x60, 123,  // LD V0, 123
+          0xF0, 0x33, // LD B, V0
+          0x60, 45,   // LD V0, 45
+          0xF0, 0x33, // LD B, V0
+      });
+
+  cow_statemachine machine(rom);
+  cow_statemachine other(rom);
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_STEP(machine, 0);
+  }
+  ASSERT_EQ(machine.memory()[0xE00], 1);
+  ASSERT_EQ(machine.memory()[0xE02], 3);
+  ASSERT_EQ(machine.backing_memory().private_pages(), 1);
+
+  // The ROM and the other machine never see the write.
+  ASSERT_EQ((*rom)[0xE00], 0);
+  ASSERT_EQ(other.memory()[0xE00], 0);
+  ASSERT_EQ(other.backing_memory().private_pages(), 0);
+
+  // A clone shares the written page until it writes to it itself.
+  cow_statemachine clone = machine;
+  ASSERT_STEP(clone, 0);
+  ASSERT_STEP(clone, 0);
+  ASSERT_EQ(clone.memory()[0xE01], 4);
+  ASSERT_EQ(clone.memory()[0xE02], 5);
+  ASSERT_EQ(machine.memory()[0xE01], 2);
+  ASSERT_EQ(machine.memory()[0xE02], 3);
+  auto mem = machine.memory();
+  ASSERT_TRUE(std::equal(mem.begin(), mem.begin() + 10, rom->begin()));
+}
+
+TEST(StateMachineTest, TestCopyOnWritePageReleasedByAnotherThread) {
+  cow_memory<0x1000> memory(rom_image<0x1000>{});
+  memory.write(0x300, 1);
+  for (uint8_t i = 0; i < 50; ++i) {
+    // The clone reads the shared page on its own thread and drops it there;
+    // the original may then write to the page in place, racing with nothing.
+    uint8_t seen = 0;
+    std::thread reader([clone = memory, &seen] { seen = clone.read(0x300); });
+    memory.write(0x300, i + 2);
+    reader.join();
+    ASSERT_EQ(seen, i + 1);
+    ASSERT_EQ(memory.read(0x300), i + 2);
+  }
+}
+
+TEST(StateMachineTest, TestInstructionFusion) {
+  std::initializer_list<uint16_t> instructions = {
+      0x6005, // LD V0, 5
+      0x6103, // LD V1, 3
+      0xF029, // LD F, V0
+      0xD015, // DRW V0, V1, 5
+      0xA000, // LD I, 0x000
+      0xD105, // DRW V1, V0, 5
+      0x6200, // LD V2, 0
+      0x7201, // ADD V2, 1
+      0x3210, // SE V2, 16
+      0x100E, // JP 0x00E
+      0xA100, // LD I, 0x100
+      0xF233, // LD B, V2
+      0xF265, // LD V2, [I]
+      0x101A, // JP 0x01A
+  };
+  statemachine plain(instructions);
+  statemachine fused(instructions, {.fuse_instructions = true});
+
+  unsigned plain_steps = 0, fused_steps = 0;
+  while (plain.cycles() < 100) {
+    ASSERT_STEP(plain, 0);
+    ++plain_steps;
+  }
+  while (fused.cycles() < 100) {
+    ASSERT_STEP(fused, 0);
+    ++fused_steps;
+  }
+
+  // Fused steps retire several instructions at once but land on the same
+  // state for the same cycle count.
+  ASSERT_EQ(fused.cycles(), plain.cycles());
+  ASSERT_LT(fused_steps, plain_steps);
+  ASSERT_EQ(fused.pc(), plain.pc());
+  ASSERT_EQ(fused.reg_I(), plain.reg_I());
+  ASSERT_TRUE(std::ranges::equal(fused.regs(), plain.regs()));
+  ASSERT_EQ(fused.display(), plain.display());
+  ASSERT_TRUE(std::ranges::equal(fused.memory(), plain.memory()));
+  ASSERT_EQ(fused.regs()[0], 0);
+  ASSERT_EQ(fused.regs()[1], 1);
+  ASSERT_EQ(fused.regs()[2], 6);
+}
+
+TEST(StateMachineTest, TestBreakpoints) {
+  std::initializer_list<uint16_t> instructions = {
+      0x6000, // LD V0, 0
+      0x7001, // ADD V0, 1
+      0xA123, // LD I, 0x123
+      0x1002, // JP 0x002
+  };
+  statemachine machine(instructions);
+  machine.add_breakpoint({.pc = 0x004});
+  machine.add_breakpoint({.pc = 0x002, .operand = 0, .value = 2});
+
+  ASSERT_STEP(machine, 0);
+  ASSERT_STEP(machine, 0);
+  ASSERT_STEP(machine, 0, statemachine::BREAKPOINT);
+  ASSERT_EQ(machine.pc(), 0x004);
+  ASSERT_EQ(machine.cycles(), 2);
+  // Stepping again resumes past the breakpoint.
+  ASSERT_STEP(machine, 0);
+  ASSERT_EQ(machine.reg_I(), 0x123);
+
+  machine.remove_breakpoint(0x004);
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_STEP(machine, 0);
+  }
+  // V0 is now 2, so the conditional breakpoint fires.
+  ASSERT_STEP(machine, 0, statemachine::BREAKPOINT);
+  ASSERT_EQ(machine.pc(), 0x002);
+  ASSERT_EQ(machine.regs()[0], 2);
+
+  machine.remove_breakpoint(0x002);
+  machine.add_breakpoint(
+      {.pc = 0x006, .operand = statemachine::BREAK_ON_I, .value = 0x123});
+  ASSERT_STEP(machine, 0);
+  ASSERT_STEP(machine, 0);
+  ASSERT_STEP(machine, 0, statemachine::BREAKPOINT);
+  ASSERT_EQ(machine.pc(), 0x006);
+}
+
+TEST(StateMachineTest, TestWatchpoints) {
+  std::initializer_list<uint16_t> instructions = {
+      0xA300,        // LD I, 0x300
+      0x6000 | 123u, // LD V0, 123
+      0xF033,        // LD B, V0
+      0xF265,        // LD V2, [I]
+      0xA400,        // LD I, 0x400
+      0xD011,        // DRW V0, V1, 1
+  };
+  statemachine machine(instructions, {.fuse_instructions = true});
+  machine.add_watchpoint(
+      {.begin = 0x302, .end = 0x303, .mask = statemachine::ACCESS_WRITE});
+  machine.add_watchpoint(
+      {.begin = 0x400, .end = 0x401, .mask = statemachine::ACCESS_READ});
+
+  ASSERT_STEP(machine, 0);
+  ASSERT_STEP(machine, 0);
+  // The write to 0x302 stops the Fx33; Fx65 pair after its first half.
+  ASSERT_STEP(machine, 0, statemachine::WATCHPOINT);
+  ASSERT_EQ(machine.pc(), 0x006);
+  ASSERT_EQ(machine.last_watch_hit().addr, 0x302);
+  ASSERT_EQ(machine.last_watch_hit().kind, statemachine::ACCESS_WRITE);
+  ASSERT_STEP(machine, 0);
+  ASSERT_EQ(machine.regs()[2], 3);
+  ASSERT_STEP(machine, 0, statemachine::WATCHPOINT);
+  ASSERT_EQ(machine.pc(), 0x00C);
+  ASSERT_EQ(machine.last_watch_hit().addr, 0x400);
+  ASSERT_EQ(machine.last_watch_hit().kind, statemachine::ACCESS_READ);
+
+  machine.clear_watchpoints();
+  statemachine unwatched(instructions, {.fuse_instructions = true});
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_STEP(unwatched, 0);
+  }
+  ASSERT_EQ(unwatched.pc(), 0x00C);
+  ASSERT_EQ(unwatched.display(), machine.display());
+}
+
+TEST(StateMachineTest, TestDirtyPages) {
+  std::initializer_list<uint16_t> instructions = {
+      0xA33F, // LD I, 0x33F
+      0xF133, // LD B, V1 (straddles pages 12 and 13)
+      0xAFF0, // LD I, 0xFF0
+      0xF255, // LD [I], V2 (page 63)
+  };
+  statemachine machine(instructions, {.quirk_load_store = true});
+  ASSERT_EQ(statemachine::DIRTY_PAGE_SIZE, 64);
+  ASSERT_EQ(machine.dirty_pages().size(), 1);
+  ASSERT_EQ(machine.dirty_pages()[0], 0);
+
+  ASSERT_STEP(machine, 0);
+  ASSERT_STEP(machine, 0);
+  ASSERT_EQ(machine.dirty_pages()[0], (uint64_t{1} << 12) | (1 << 13));
+  ASSERT_EQ(machine.page_generation(12), 1);
+  ASSERT_EQ(machine.page_generation(13), 1);
+
+  machine.clear_dirty_pages();
+  ASSERT_EQ(machine.dirty_pages()[0], 0);
+  ASSERT_STEP(machine, 0);
+  ASSERT_STEP(machine, 0);
+  ASSERT_EQ(machine.dirty_pages()[0], uint64_t{1} << 63);
+  ASSERT_EQ(machine.page_generation(12), 1);
+  ASSERT_EQ(machine.page_generation(63), 1);
+  ASSERT_EQ(xochip_statemachine::DIRTY_PAGES, 256);
+}
+
+TEST(StateMachineTest, TestConstantEvaluatedBoot) {
+  constexpr auto booted = run_boot_sequence(
+      statemachine(
+          {
+              0x6005, // LD V0, 5
+              0x7001, // ADD V0, 1
+              0xA000, // LD I, 0x000
+              0xD012, // DRW V0, V1, 2
+              0xC0FF, // RND V0, 0xFF
+          },
+          {.seed = 1}),
+      1000);
+  static_assert(booted.pc() == 0x008);
+  static_assert(booted.regs()[0] == 6);
+  static_assert(booted.display_generation() == 1);
+
+  // Booting at compile time and running on matches running from scratch.
+  statemachine machine(
+      {0x6005, 0x7001, 0xA000, 0xD012, 0xC0FF}, {.seed = 1});
+  for (int i = 0; i < 5; ++i) {
+    ASSERT_STEP(machine, 0);
+  }
+  statemachine resumed = booted;
+  ASSERT_STEP(resumed, 0);
+  ASSERT_TRUE(std::ranges::equal(resumed.regs(), machine.regs()));
+  ASSERT_EQ(resumed.display(), machine.display());
+}
+
+TEST(StateMachineTest, TestStateHash) {
+  // Both loops put every register, memory and the display back the way they
+  // were, so the machine is in its initial state again after each pass.
+  std::initializer_list<uint16_t> draw_loop = {
+      0xA00A, // LD I, 0x00A
+      0xD005, // DRW V0, V0, 5
+      0xD005, // DRW V0, V0, 5 (erases it again and sets VF)
+      0x6F00, // LD VF, 0
+      0xA000, // LD I, 0x000
+      0x1000, // JP 0x000
+  };
+  std::initializer_list<uint16_t> store_loop = {
+      0x6001, // LD V0, 1
+      0xA100, // LD I, 0x100
+      0xF055, // LD [I], V0
+      0x6000, // LD V0, 0
+      0xF055, // LD [I], V0
+      0xA000, // LD I, 0x000
+      0x1000, // JP 0x000
+  };
+  for (auto instructions : {draw_loop, store_loop}) {
+    statemachine machine(instructions, {.quirk_load_store = true});
+    uint64_t initial = machine.state_hash();
+    std::vector<uint64_t> seen = {initial};
+    for (size_t i = 0; i < instructions.size(); ++i) {
+      ASSERT_STEP(machine, 0);
+      seen.push_back(machine.state_hash());
+    }
+    ASSERT_EQ(seen.back(), initial);
+    ASSERT_GT(machine.cycles(), 0);
+    std::sort(seen.begin(), seen.end() - 1);
+    ASSERT_EQ(std::unique(seen.begin(), seen.end() - 1), seen.end() - 1)
+        << "every intermediate state should hash differently";
+  }
+
+  statemachine a({0x6001}), b({0x6002});
+  ASSERT_NE(a.state_hash(), b.state_hash());
+  ASSERT_STEP(a, 0);
+  ASSERT_NE(a.state_hash(), b.state_hash());
+}
+
+TEST(StateMachineTest, TestPcOutOfRange) {
+  statemachine machine({}, {.pc = statemachine::MEMORY_SIZE});
+  ASSERT_STEP(machine, 0, statemachine_common::PC_OUT_OF_RANGE);
+  statemachine unaligned({}, {.pc = 0x201});
+  ASSERT_STEP(unaligned, 0, statemachine_common::PC_UNALIGNED);
+}
+
+TEST(StateMachineTest, TestCycleCosts) {
+  constexpr cycle_costs vip = cycle_costs::cosmac_vip();
+  std::initializer_list<uint16_t> instructions = {
+      0x6004, // LD V0, 4
+      0xA00A, // LD I, 0x00A
+      0xD005, // DRW V0, V0, 5 (x = 4 straddles two display bytes)
+      0x6000, // LD V0, 0
+      0xA00A, // LD I, 0x00A
+      0xD005, // DRW V0, V0, 5 (x = 0 is byte-aligned)
+  };
+  uint64_t load = vip.fetch + vip.by_group[0x6];
+  uint64_t set_i = vip.fetch + vip.by_group[0xA];
+  uint64_t aligned = vip.fetch + vip.by_group[0xD] + 5 * vip.sprite_row;
+  uint64_t unaligned = aligned + 5 * vip.unaligned_row;
+  ASSERT_EQ(vip.cost(0xD005, 4), unaligned);
+  ASSERT_EQ(vip.cost(0xD005, 0), aligned);
+
+  // Fused pairs must cost the same as their parts.
+  for (bool fuse : {false, true}) {
+    statemachine machine(instructions,
+                         {.fuse_instructions = fuse, .costs = &vip});
+    while (machine.pc() < 2 * instructions.size()) {
+      ASSERT_STEP(machine, 0);
+    }
+    ASSERT_EQ(machine.cycles(), 2 * (load + set_i) + aligned + unaligned);
+  }
+
+  // Without a model every instruction is one cycle.
+  statemachine flat(instructions);
+  for (size_t i = 0; i < instructions.size(); ++i) {
+    ASSERT_STEP(flat, 0);
+  }
+  ASSERT_EQ(flat.cycles(), instructions.size());
+}
@@ -0,0 +1,197 @@
+#include <algorithm>
+#include <barrier>
+#include <map>
+#include <thread>
+
+#include "sweep.hpp"
+
+std::string quirk_names(unsigned mask) {
+  std::string ret;
+  for (size_t i = 0; i < std::size(QUIRKS); ++i) {
+    if (mask & (1u << i)) {
+      ret += (ret.empty() ? "" : "+") + std::string(QUIRKS[i].name);
+    }
+  }
+  return ret.empty() ? "none" : ret;
+}
+
+namespace {
+
+/// Returns the quirks that decide which group a configuration is in.
+unsigned explaining_quirks(const std::vector<std::vector<unsigned>> &groups) {
+  unsigned differing = 0;
+  unsigned uniform = ~0u;
+  for (const auto &group : groups) {
+    for (unsigned config : group) {
+      differing |= config ^ groups[0][0];
+      uniform &= ~(config ^ group[0]);
+    }
+  }
+  unsigned candidates = differing & uniform;
+  // The candidates explain the grouping only if no two groups agree on them.
+  std::vector<unsigned> keys;
+  for (const auto &group : groups) {
+    keys.push_back(group[0] & candidates);
+  }
+  std::sort(keys.begin(), keys.end());
+  bool distinct = std::adjacent_find(keys.begin(), keys.end()) == keys.end();
+  return distinct ? candidates : differing;
+}
+
+class sweep_state {
+public:
+  sweep_state(const rom_image<statemachine::MEMORY_SIZE> &rom,
+              const sweep_config &conf)
+      : m_conf(conf) {
+    unsigned configs = 1u << std::size(QUIRKS);
+    for (unsigned mask = 0; mask < configs; ++mask) {
+      statemachine::init_conf init = conf.base;
+      if (init.cycles_per_tick == 0) {
+        init.cycles_per_tick = conf.cycles_per_frame;
+      }
+      for (size_t i = 0; i < std::size(QUIRKS); ++i) {
+        QUIRKS[i].set(init, mask & (1u << i));
+      }
+      m_machines.emplace_back(rom, init);
+    }
+    m_group.assign(configs, 0);
+    m_active.assign(configs, true);
+    m_after.resize(configs);
+    m_result.stopped.assign(configs, 0);
+    m_result.statuses.assign(configs, statemachine_common::NO_ERROR);
+  }
+
+  /// Runs every `stride`th configuration starting at `first` until the
+  /// sweep is over.
+  template <class Barrier>
+  void work(Barrier &barrier, unsigned first, unsigned stride) {
+    while (!m_done) {
+      uint16_t keystate = m_frame < m_conf.inputs.size()
+                              ? m_conf.inputs[m_frame]
+                              : 0;
+      uint64_t end = uint64_t{m_frame + 1} * m_conf.cycles_per_frame;
+      for (unsigned i = first; i < m_machines.size(); i += stride) {
+        if (m_active[i]) {
+          run(i, keystate, end);
+        }
+      }
+      barrier.arrive_and_wait();
+    }
+  }
+
+  /// Regroups the configurations after a frame; runs on one thread while
+  /// the others wait.
+  void end_frame() noexcept {
+    // Configurations that were in the same group stay together only if they
+    // still agree.
+    std::map<std::pair<unsigned, frame_state>, std::vector<unsigned>> split;
+    for (unsigned i = 0; i < m_machines.size(); ++i) {
+      if (m_active[i]) {
+        ++m_result.frames_run;
+        split[{m_group[i], m_after[i]}].push_back(i);
+      }
+    }
+
+    std::map<unsigned, std::vector<std::vector<unsigned>>> by_old_group;
+    unsigned next_group = 0;
+    for (auto &[key, members] : split) {
+      by_old_group[key.first].push_back(members);
+      bool errored = key.second.status < 0;
+      for (unsigned i : members) {
+        m_group[i] = next_group;
+        if (members.size() == 1 || errored || m_frame + 1 >= m_conf.frames) {
+          m_active[i] = false;
+          m_result.stopped[i] = m_frame;
+          m_result.statuses[i] = key.second.status;
+        }
+      }
+      ++next_group;
+    }
+
+    for (auto &[old_group, groups] : by_old_group) {
+      if (groups.size() < 2) {
+        continue;
+      }
+      std::sort(groups.begin(), groups.end());
+      bool visible = false;
+      for (const auto &group : groups) {
+        visible |= m_after[group[0]].display != m_after[groups[0][0]].display;
+      }
+      m_result.divergences.push_back({.frame = m_frame,
+                                      .groups = groups,
+                                      .quirks = explaining_quirks(groups),
+                                      .visible = visible});
+    }
+
+    ++m_frame;
+    m_done = std::none_of(m_active.begin(), m_active.end(),
+                          [](bool active) { return active; });
+  }
+
+  sweep_result result() && { return std::move(m_result); }
+
+private:
+  struct frame_state {
+    uint64_t hash;
+    uint64_t display;
+    statemachine_common::status status;
+
+    auto operator<=>(const frame_state &) const = default;
+  };
+
+  void run(unsigned i, uint16_t keystate, uint64_t end) {
+    statemachine &mach = m_machines[i];
+    auto status = statemachine_common::NO_ERROR;
+    while (mach.cycles() < end) {
+      status = mach.step(keystate);
+      if (status == statemachine_common::WAITING_FOR_KEYPRESS) {
+        mach.idle_until(end);
+      } else if (status < 0) {
+        break;
+      }
+    }
+    if (status > 0) {
+      // Waiting for a key is normal; only errors are worth reporting.
+      status = statemachine_common::NO_ERROR;
+    }
+    m_after[i] = {.hash = mach.state_hash(),
+                  .display = mach.display_hash(),
+                  .status = status};
+  }
+
+  const sweep_config &m_conf;
+  std::vector<statemachine> m_machines;
+  /// Per configuration: which group of identical configurations it is in,
+  /// whether it still runs, and its state after the current frame.
+  std::vector<unsigned> m_group;
+  std::vector<bool> m_active;
+  std::vector<frame_state> m_after;
+  unsigned m_frame = 0;
+  bool m_done = false;
+  sweep_result m_result;
+};
+
+} // namespace
+
+sweep_result
+sweep_quirks(const rom_image<statemachine::MEMORY_SIZE> &rom,
+             const sweep_config &conf) {
+  sweep_state state(rom, conf);
+  if (conf.frames == 0) {
+    return std::move(state).result();
+  }
+  unsigned configs = 1u << std::size(QUIRKS);
+  unsigned threads = std::clamp(conf.threads, 1u, configs);
+  auto end_frame = [&state]() noexcept { state.end_frame(); };
+  std::barrier barrier(threads, end_frame);
+
+  std::vector<std::thread> workers;
+  for (unsigned i = 1; i < threads; ++i) {
+    workers.emplace_back([&, i] { state.work(barrier, i, threads); });
+  }
+  state.work(barrier, 0, threads);
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  return std::move(state).result();
+}
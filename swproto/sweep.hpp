@@ -0,0 +1,82 @@
+#ifndef SWIMP_SWEEP_H
+#define SWIMP_SWEEP_H
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "memory.hpp"
+#include "statemachine.hpp"
+
+/// An init_conf switch whose behaviour differs between interpreters.
+struct quirk {
+  const char *name;
+  void (*set)(statemachine::init_conf &conf, bool on);
+};
+
+/// Every quirk the interpreter knows. Configurations are numbered by mask,
+/// with bit i set when QUIRKS[i] is on; new quirks only need adding here.
+inline const quirk QUIRKS[] = {
+    {"shift",
+     [](statemachine::init_conf &conf, bool on) { conf.quirk_shift = on; }},
+    {"load_store",
+     [](statemachine::init_conf &conf, bool on) {
+       conf.quirk_load_store = on;
+     }},
+};
+
+/// Names the quirks in `mask`, e.g. "shift+load_store", or "none".
+std::string quirk_names(unsigned mask);
+
+struct sweep_config {
+  /// Settings shared by every configuration; its quirk bits are ignored and
+  /// a cycles_per_tick of 0 means cycles_per_frame.
+  statemachine::init_conf base;
+  /// Keystate for each frame; keys are released once it runs out.
+  std::vector<uint16_t> inputs;
+  unsigned frames = 600;
+  uint32_t cycles_per_frame = 700 / 60;
+  unsigned threads = 1;
+};
+
+/// A frame in which configurations that had been identical stopped being so.
+struct divergence {
+  unsigned frame;
+  /// The configurations that were identical before the frame, grouped by
+  /// their state after it.
+  std::vector<std::vector<unsigned>> groups;
+  /// Quirks whose settings decide the grouping, as a configuration mask. If
+  /// no subset of quirks does on its own, every quirk that differs.
+  unsigned quirks;
+  /// True if the groups' displays differ, not only their internal state.
+  bool visible;
+};
+
+struct sweep_result {
+  /// In frame order.
+  std::vector<divergence> divergences;
+  /// Per configuration, the frame it stopped after: the one where it
+  /// diverged from all others or reported an error, or the last one.
+  std::vector<unsigned> stopped;
+  /// Per configuration, the status that stopped it, or NO_ERROR.
+  std::vector<statemachine_common::status> statuses;
+  /// Frames actually run, summed over configurations.
+  uint64_t frames_run = 0;
+};
+
+/**
+ * Runs `rom` under every combination of QUIRKS and reports the frames in
+ * which the combinations start behaving differently.
+ *
+ * All configurations advance one frame at a time in lockstep, spread over
+ * the worker threads. After each frame they are grouped by state_hash(); a
+ * configuration left in a group of its own has nothing left to be compared
+ * against and stops, so a sweep costs little more than the frames up to the
+ * last divergence.
+ */
+sweep_result
+sweep_quirks(const rom_image<statemachine::MEMORY_SIZE> &rom,
+             const sweep_config &conf);
+
+#endif // SWIMP_SWEEP_H
@@ -0,0 +1,65 @@
+#include <algorithm>
+#include <gtest/gtest.h>
+
+#include "font.hpp"
+#include "sweep.hpp"
+
+TEST(SweepTest, TestFindsEachQuirk) {
+  // Waits, shifts and draws the result, waits again, then stores twice.
+  const uint16_t program[] = {
+      0x6005, // LD V0, 5
+      0xF015, // LD DT, V0
+      0xF007, // LD V0, DT
+      0x3000, // SE V0, 0
+      0x1204, // JP 0x204
+      0x6103, // LD V1, 3
+      0x8016, // SHR V0, V1 (0 with the shift quirk, 1 without)
+      0xF029, // LD F, V0
+      0xD005, // DRW V0, V0, 5
+      0x6005, // LD V0, 5
+      0xF015, // LD DT, V0
+      0xF007, // LD V0, DT
+      0x3000, // SE V0, 0
+      0x1216, // JP 0x216
+      0xA300, // LD I, 0x300
+      0xF055, // LD [I], V0
+      0x6001, // LD V0, 1
+      0xF055, // LD [I], V0 (to 0x300 with the load/store quirk, else 0x301)
+      0x1224, // JP 0x224
+  };
+  rom_image<statemachine::MEMORY_SIZE> rom{};
+  std::copy(font.begin(), font.end(), rom.begin());
+  for (size_t i = 0; i < std::size(program); ++i) {
+    rom[0x200 + 2 * i] = program[i] >> 8;
+    rom[0x201 + 2 * i] = program[i] & 0xFF;
+  }
+
+  sweep_config conf{.base = {.pc = 0x200}, .frames = 100, .threads = 3};
+  auto result = sweep_quirks(rom, conf);
+
+  ASSERT_EQ(result.divergences.size(), 3);
+  const divergence &shift = result.divergences[0];
+  ASSERT_GT(shift.frame, 0);
+  ASSERT_EQ(shift.quirks, 1);
+  ASSERT_TRUE(shift.visible);
+  ASSERT_EQ(shift.groups,
+            (std::vector<std::vector<unsigned>>{{0, 2}, {1, 3}}));
+
+  // Both halves then split on the load/store quirk in the same frame,
+  // without any visible difference.
+  for (size_t i = 1; i < 3; ++i) {
+    const divergence &store = result.divergences[i];
+    ASSERT_GT(store.frame, shift.frame);
+    ASSERT_EQ(store.frame, result.divergences[1].frame);
+    ASSERT_EQ(store.quirks, 2);
+    ASSERT_FALSE(store.visible);
+  }
+
+  // Everything stopped at the last divergence rather than running on.
+  for (unsigned stopped : result.stopped) {
+    ASSERT_EQ(stopped, result.divergences[1].frame);
+  }
+  ASSERT_LT(result.frames_run, 4 * conf.frames);
+  ASSERT_EQ(quirk_names(3), "shift+load_store");
+  ASSERT_EQ(quirk_names(0), "none");
+}
@@ -0,0 +1,106 @@
+#include <cerrno>
+#include <unistd.h>
+
+#include "terminal.hpp"
+
+terminal_renderer::terminal_renderer(unsigned width, unsigned height,
+                                     cells mode, int fd)
+    : m_width(width), m_height(height), m_mode(mode), m_fd(fd),
+      m_cell_width(mode == cells::BRAILLE ? 2 : 1),
+      m_cell_height(mode == cells::BRAILLE ? 4 : 2),
+      m_columns((width + m_cell_width - 1) / m_cell_width),
+      m_rows((height + m_cell_height - 1) / m_cell_height),
+      m_bytes_written(0) {}
+
+terminal_renderer::~terminal_renderer() {
+  if (m_shown.empty()) {
+    return;
+  }
+  m_out += "\x1b[" + std::to_string(m_rows + 1) + ";1H\x1b[?25h";
+  flush();
+}
+
+uint8_t terminal_renderer::cell_bits(std::span<const uint8_t> display,
+                                     unsigned column, unsigned row) const {
+  auto pixel = [&](unsigned x, unsigned y) -> uint8_t {
+    if (x >= m_width || y >= m_height) {
+      return 0;
+    }
+    return (display[y * (m_width / 8) + x / 8] >> (7 - x % 8)) & 1;
+  };
+  unsigned x = column * m_cell_width;
+  unsigned y = row * m_cell_height;
+  if (m_mode == cells::HALF_BLOCK) {
+    return pixel(x, y) | (pixel(x, y + 1) << 1);
+  }
+  // Braille dots 1-8, in the order Unicode assigns them bits.
+  return pixel(x, y) | (pixel(x, y + 1) << 1) | (pixel(x, y + 2) << 2) |
+         (pixel(x + 1, y) << 3) | (pixel(x + 1, y + 1) << 4) |
+         (pixel(x + 1, y + 2) << 5) | (pixel(x, y + 3) << 6) |
+         (pixel(x + 1, y + 3) << 7);
+}
+
+void terminal_renderer::append_cell(uint8_t bits) {
+  uint32_t code_point;
+  if (m_mode == cells::BRAILLE) {
+    code_point = 0x2800 + bits;
+  } else {
+    // Space, upper half block, lower half block, full block.
+    const uint32_t blocks[] = {0x20, 0x2580, 0x2584, 0x2588};
+    code_point = blocks[bits];
+  }
+  if (code_point < 0x80) {
+    m_out += static_cast<char>(code_point);
+  } else {
+    m_out += static_cast<char>(0xE0 | (code_point >> 12));
+    m_out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+    m_out += static_cast<char>(0x80 | (code_point & 0x3F));
+  }
+}
+
+void terminal_renderer::draw(std::span<const uint8_t> display) {
+  bool first = m_shown.empty();
+  if (first) {
+    // Clear the screen and hide the cursor; every cell gets drawn below.
+    m_out += "\x1b[2J\x1b[?25l";
+    m_shown.assign(m_columns * m_rows, 0);
+  }
+
+  for (unsigned row = 0; row < m_rows; ++row) {
+    // Whether the cursor is already where the next changed cell goes.
+    bool in_place = false;
+    for (unsigned column = 0; column < m_columns; ++column) {
+      uint8_t bits = cell_bits(display, column, row);
+      uint8_t &shown = m_shown[row * m_columns + column];
+      if (bits == shown && !first) {
+        in_place = false;
+        continue;
+      }
+      if (!in_place) {
+        m_out += "\x1b[" + std::to_string(row + 1) + ';' +
+                 std::to_string(column + 1) + 'H';
+        in_place = true;
+      }
+      append_cell(bits);
+      shown = bits;
+    }
+  }
+  flush();
+}
+
+void terminal_renderer::flush() {
+  size_t done = 0;
+  while (done < m_out.size()) {
+    ssize_t count = write(m_fd, m_out.data() + done, m_out.size() - done);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // The terminal went away; drop the frame rather than stall the run.
+      break;
+    }
+    done += count;
+  }
+  m_bytes_written += done;
+  m_out.clear();
+}
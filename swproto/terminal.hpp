@@ -0,0 +1,60 @@
+#ifndef SWIMP_TERMINAL_H
+#define SWIMP_TERMINAL_H
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+/**
+ * Draws packed 1bpp framebuffers on an ANSI terminal.
+ *
+ * Pixels are packed into Unicode cells: half blocks hold 1x2 pixels (64x16
+ * cells for a 64x32 display) and braille patterns hold 2x4 (32x8 cells).
+ * After the first frame, only cells that changed are redrawn, each run of
+ * adjacent changed cells behind a single cursor move, and the whole frame
+ * goes out in one write(). A static screen costs nothing at all.
+ */
+class terminal_renderer {
+public:
+  enum class cells { HALF_BLOCK, BRAILLE };
+
+  terminal_renderer(unsigned width, unsigned height, cells mode, int fd = 1);
+
+  terminal_renderer(const terminal_renderer &) = delete;
+  terminal_renderer &operator=(const terminal_renderer &) = delete;
+
+  /// Leaves the cursor, visible again, below the picture.
+  ~terminal_renderer();
+
+  /// Draws a frame of width * height / 8 bytes.
+  void draw(std::span<const uint8_t> display);
+
+  /// Bytes written so far, to see what a link is being asked to carry.
+  inline uint64_t bytes_written() const { return m_bytes_written; };
+
+private:
+  /// The pattern of pixels covered by the cell at (column, row).
+  uint8_t cell_bits(std::span<const uint8_t> display, unsigned column,
+                    unsigned row) const;
+
+  /// Appends the UTF-8 character showing `bits`.
+  void append_cell(uint8_t bits);
+
+  void flush();
+
+  unsigned m_width;
+  unsigned m_height;
+  cells m_mode;
+  int m_fd;
+  unsigned m_cell_width;
+  unsigned m_cell_height;
+  unsigned m_columns;
+  unsigned m_rows;
+  /// What each cell currently shows; empty until the first frame.
+  std::vector<uint8_t> m_shown;
+  std::string m_out;
+  uint64_t m_bytes_written;
+};
+
+#endif // SWIMP_TERMINAL_H
@@ -0,0 +1,57 @@
+#include <array>
+#include <gtest/gtest.h>
+#include <string>
+#include <unistd.h>
+
+#include "terminal.hpp"
+
+/// Reads whatever the renderer has written to the pipe so far.
+static std::string drain(int fd) {
+  std::array<char, 4096> buffer;
+  ssize_t count = read(fd, buffer.data(), buffer.size());
+  return std::string(buffer.data(), count > 0 ? count : 0);
+}
+
+TEST(TerminalTest, TestOnlyChangedCellsAreRedrawn) {
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  {
+    // 16x4 pixels: 16x2 half-block cells.
+    terminal_renderer screen(16, 4, terminal_renderer::cells::HALF_BLOCK,
+                             fds[1]);
+    std::array<uint8_t, 8> display{};
+    display[0] = 0x80; // Top-left pixel.
+    screen.draw(display);
+    std::string first = drain(fds[0]);
+    ASSERT_TRUE(first.starts_with("\x1b[2J\x1b[?25l\x1b[1;1H▀"));
+    ASSERT_EQ(screen.bytes_written(), first.size());
+
+    screen.draw(display);
+    ASSERT_EQ(screen.bytes_written(), first.size());
+
+    display[2] = 0x01; // Row 1, pixel 7: the bottom of cell (7, 0).
+    display[7] = 0x01; // Row 3, pixel 15: the bottom of cell (15, 1).
+    screen.draw(display);
+    ASSERT_EQ(drain(fds[0]), "\x1b[1;8H▄\x1b[2;16H▄");
+  }
+  ASSERT_EQ(drain(fds[0]), "\x1b[3;1H\x1b[?25h");
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(TerminalTest, TestBraille) {
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  {
+    terminal_renderer screen(8, 4, terminal_renderer::cells::BRAILLE, fds[1]);
+    std::array<uint8_t, 4> display = {0xC0, 0x40, 0x00, 0x80};
+    screen.draw(display);
+    drain(fds[0]);
+    display[3] = 0xC0;
+    screen.draw(display);
+    // Dots 1, 4, 5, 7 and 8 of the first cell.
+    ASSERT_EQ(drain(fds[0]), "\x1b[1;1H⣙");
+  }
+  close(fds[0]);
+  close(fds[1]);
+}
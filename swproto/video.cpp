@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <cstring>
+
+#include "video.hpp"
+
+static const char HEADER_MAGIC[8] = {'C', '8', 'V', 'I', 'D', 'E', 'O', '\0'};
+static const char TRAILER_MAGIC[8] = {'C', '8', 'V', 'I', 'D', 'I', 'D', 'X'};
+static const uint16_t VERSION = 1;
+static const size_t HEADER_SIZE = 8 + 4 * 2;
+static const size_t TRAILER_SIZE = 8 + 8 + 8;
+
+static void put_u16(std::ostream &os, uint16_t v) {
+  char bytes[2] = {static_cast<char>(v), static_cast<char>(v >> 8)};
+  os.write(bytes, 2);
+}
+
+static void put_u64(std::ostream &os, uint64_t v) {
+  for (unsigned i = 0; i < 8; ++i, v >>= 8) {
+    os.put(static_cast<char>(v & 0xFF));
+  }
+}
+
+static void put_varint(std::vector<uint8_t> &out, uint64_t v) {
+  for (; v >= 0x80; v >>= 7) {
+    out.push_back((v & 0x7F) | 0x80);
+  }
+  out.push_back(v);
+}
+
+static void put_varint(std::ostream &os, uint64_t v) {
+  std::vector<uint8_t> bytes;
+  put_varint(bytes, v);
+  os.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+}
+
+static bool get_u16(std::istream &is, uint16_t &v) {
+  uint8_t bytes[2];
+  if (!is.read(reinterpret_cast<char *>(bytes), 2)) {
+    return false;
+  }
+  v = bytes[0] | (bytes[1] << 8);
+  return true;
+}
+
+static bool get_u64(std::istream &is, uint64_t &v) {
+  uint8_t bytes[8];
+  if (!is.read(reinterpret_cast<char *>(bytes), 8)) {
+    return false;
+  }
+  v = 0;
+  for (unsigned i = 8; i-- > 0;) {
+    v = (v << 8) | bytes[i];
+  }
+  return true;
+}
+
+static bool get_varint(std::istream &is, uint64_t &v) {
+  v = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    int byte = is.get();
+    if (byte == std::char_traits<char>::eof()) {
+      return false;
+    }
+    v |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool get_varint(std::span<const uint8_t> in, size_t &pos, uint64_t &v) {
+  v = 0;
+  for (unsigned shift = 0; shift < 64 && pos < in.size(); shift += 7) {
+    uint8_t byte = in[pos++];
+    v |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// Run-length encodes `frame ^ previous` (or just `frame` if `previous` is
+/// empty) as alternating zero runs and literal runs.
+static void rle_xor_encode(std::span<const uint8_t> previous,
+                           std::span<const uint8_t> frame,
+                           std::vector<uint8_t> &out) {
+  auto data = [&](size_t i) -> uint8_t {
+    return previous.empty() ? frame[i] : frame[i] ^ previous[i];
+  };
+  size_t size = previous.empty() ? frame.size()
+                                 : std::min(frame.size(), previous.size());
+  size_t i = 0;
+  while (i < size) {
+    size_t zeros_begin = i;
+    while (i < size && data(i) == 0) {
+      ++i;
+    }
+    put_varint(out, i - zeros_begin);
+
+    // A single zero inside a literal run is cheaper than starting a new run.
+    size_t literal_begin = i;
+    while (i < size && (data(i) != 0 || (i + 1 < size && data(i + 1) != 0))) {
+      ++i;
+    }
+    put_varint(out, i - literal_begin);
+    for (size_t j = literal_begin; j < i; ++j) {
+      out.push_back(data(j));
+    }
+  }
+}
+
+void append_frame_record(std::span<const uint8_t> previous,
+                         std::span<const uint8_t> frame,
+                         std::vector<uint8_t> &out) {
+  out.push_back(previous.empty() ? 'K' : 'D');
+  size_t payload_begin = out.size();
+  rle_xor_encode(previous, frame, out);
+
+  uint8_t size_bytes[10];
+  size_t size = out.size() - payload_begin, count = 0;
+  for (; size >= 0x80; size >>= 7) {
+    size_bytes[count++] = (size & 0x7F) | 0x80;
+  }
+  size_bytes[count++] = size;
+  out.insert(out.begin() + payload_begin, size_bytes, size_bytes + count);
+}
+
+bool apply_frame_payload(std::span<const uint8_t> payload,
+                         std::span<uint8_t> frame) {
+  size_t in = 0, out = 0;
+  while (in < payload.size()) {
+    uint64_t zeros, literals;
+    if (!get_varint(payload, in, zeros) || zeros > frame.size() - out) {
+      return false;
+    }
+    out += zeros;
+    if (!get_varint(payload, in, literals) ||
+        literals > frame.size() - out || literals > payload.size() - in) {
+      return false;
+    }
+    for (uint64_t i = 0; i < literals; ++i) {
+      frame[out++] ^= payload[in++];
+    }
+  }
+  return true;
+}
+
+std::optional<video_writer> video_writer::create(const std::string &path,
+                                                 uint16_t width,
+                                                 uint16_t height,
+                                                 uint16_t keyframe_interval) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out.is_open()) {
+    return std::nullopt;
+  }
+  out.write(HEADER_MAGIC, sizeof(HEADER_MAGIC));
+  put_u16(out, VERSION);
+  put_u16(out, width);
+  put_u16(out, height);
+  put_u16(out, std::max<uint16_t>(keyframe_interval, 1));
+  if (!out) {
+    return std::nullopt;
+  }
+  return video_writer(std::move(out), width, height,
+                      std::max<uint16_t>(keyframe_interval, 1));
+}
+
+video_writer::video_writer(std::ofstream out, uint16_t width, uint16_t height,
+                           uint16_t keyframe_interval)
+    : m_out(std::move(out)), m_keyframe_interval(keyframe_interval),
+      m_frames(0), m_previous((width / 8) * height, 0), m_closed(false) {}
+
+video_writer::~video_writer() {
+  if (m_out.is_open() && !m_closed) {
+    close();
+  }
+}
+
+void video_writer::write_frame(std::span<const uint8_t> display) {
+  size_t size = std::min(display.size(), m_previous.size());
+  bool keyframe = (m_frames % m_keyframe_interval) == 0;
+
+  if (keyframe) {
+    m_index.emplace_back(m_frames, static_cast<uint64_t>(m_out.tellp()));
+  }
+  m_record.clear();
+  append_frame_record(keyframe ? std::span<const uint8_t>() : m_previous,
+                      display.first(size), m_record);
+  std::copy_n(display.begin(), size, m_previous.begin());
+
+  m_out.write(reinterpret_cast<const char *>(m_record.data()),
+              m_record.size());
+  ++m_frames;
+}
+
+void video_writer::close() {
+  uint64_t index_offset = m_out.tellp();
+  put_varint(m_out, m_index.size());
+  for (auto [frame, offset] : m_index) {
+    put_varint(m_out, frame);
+    put_varint(m_out, offset);
+  }
+  put_u64(m_out, index_offset);
+  put_u64(m_out, m_frames);
+  m_out.write(TRAILER_MAGIC, sizeof(TRAILER_MAGIC));
+  m_out.close();
+  m_closed = true;
+}
+
+std::optional<video_reader> video_reader::open(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  char magic[8];
+  uint16_t version, width, height, keyframe_interval;
+  if (!in.read(magic, sizeof(magic)) ||
+      std::memcmp(magic, HEADER_MAGIC, sizeof(magic)) != 0 ||
+      !get_u16(in, version) || version != VERSION || !get_u16(in, width) ||
+      !get_u16(in, height) || !get_u16(in, keyframe_interval)) {
+    return std::nullopt;
+  }
+
+  video_reader reader(std::move(in), width, height);
+  auto &is = reader.m_in;
+
+  // Prefer the index in the trailer.
+  is.seekg(0, std::ios::end);
+  uint64_t file_size = is.tellg();
+  uint64_t index_offset, frames;
+  if (file_size >= HEADER_SIZE + TRAILER_SIZE &&
+      is.seekg(file_size - TRAILER_SIZE) && get_u64(is, index_offset) &&
+      get_u64(is, frames) && is.read(magic, sizeof(magic)) &&
+      std::memcmp(magic, TRAILER_MAGIC, sizeof(magic)) == 0 &&
+      is.seekg(index_offset)) {
+    uint64_t count;
+    bool ok = get_varint(is, count);
+    for (uint64_t i = 0; ok && i < count; ++i) {
+      uint64_t frame, offset;
+      ok = get_varint(is, frame) && get_varint(is, offset);
+      reader.m_index.emplace_back(frame, offset);
+    }
+    if (ok) {
+      reader.m_frame_count = frames;
+      return reader;
+    }
+  }
+
+  // No usable trailer (e.g. the recorder was killed): rebuild by scanning.
+  is.clear();
+  is.seekg(HEADER_SIZE);
+  reader.m_index.clear();
+  for (uint64_t frame = 0;; ++frame) {
+    uint64_t offset = is.tellg();
+    int type = is.get();
+    uint64_t size;
+    if ((type != 'K' && type != 'D') || !get_varint(is, size) ||
+        !is.seekg(size, std::ios::cur) ||
+        static_cast<uint64_t>(is.tellg()) > file_size) {
+      break;
+    }
+    if (type == 'K') {
+      reader.m_index.emplace_back(frame, offset);
+    }
+    reader.m_frame_count = frame + 1;
+  }
+  is.clear();
+  return reader;
+}
+
+video_reader::video_reader(std::ifstream in, uint16_t width, uint16_t height)
+    : m_in(std::move(in)), m_width(width), m_height(height), m_frame_count(0),
+      m_position(UINT64_MAX), m_current((width / 8) * height, 0) {}
+
+bool video_reader::decode_next() {
+  int type = m_in.get();
+  uint64_t size;
+  if ((type != 'K' && type != 'D') || !get_varint(m_in, size) ||
+      size > m_current.size() * 3 + 16) {
+    return false;
+  }
+  m_payload.resize(size);
+  if (!m_in.read(reinterpret_cast<char *>(m_payload.data()), size)) {
+    return false;
+  }
+  if (type == 'K') {
+    std::fill(m_current.begin(), m_current.end(), 0);
+  }
+  if (!apply_frame_payload(m_payload, m_current)) {
+    return false;
+  }
+  ++m_position;
+  return true;
+}
+
+std::span<const uint8_t> video_reader::read(uint64_t frame) {
+  if (frame >= m_frame_count) {
+    return {};
+  }
+  if (frame == m_position) {
+    return m_current;
+  }
+
+  // Jump to the closest keyframe unless simply decoding forward is closer.
+  auto keyframe = std::upper_bound(
+      m_index.begin(), m_index.end(), frame,
+      [](uint64_t f, const auto &entry) { return f < entry.first; });
+  if (keyframe != m_index.begin()) {
+    --keyframe;
+    if (m_position == UINT64_MAX || frame < m_position ||
+        keyframe->first > m_position) {
+      m_in.clear();
+      m_in.seekg(keyframe->second);
+      m_position = keyframe->first - 1;
+    }
+  }
+
+  while (m_position != frame) {
+    if (!decode_next()) {
+      m_position = UINT64_MAX;
+      return {};
+    }
+  }
+  return m_current;
+}
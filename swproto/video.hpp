@@ -0,0 +1,104 @@
+#ifndef SWIMP_VIDEO_H
+#define SWIMP_VIDEO_H
+
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+/*
+ * Recorded-video format for packed 1bpp framebuffers.
+ *
+ *   header:  "C8VIDEO\0" u16 version, u16 width, u16 height,
+ *            u16 keyframe interval
+ *   frames:  u8 type ('K' or 'D'), varint payload size, payload
+ *   index:   varint keyframe count, then per keyframe
+ *            varint frame number, varint file offset of its record
+ *   trailer: u64 index offset, u64 frame count, "C8VIDIDX"
+ *
+ * A keyframe payload is the run-length encoded frame itself. A delta payload
+ * is the run-length encoded XOR of the frame with the previous one. Runs
+ * alternate: varint count of zero bytes, varint count of literal bytes, the
+ * literal bytes; repeated until the frame is covered.
+ *
+ * All integers are little-endian.
+ */
+
+/**
+ * Appends a frame record for `frame` to `out`: a delta against `previous`, or
+ * a keyframe if `previous` is empty. Also used to stream frames to clients.
+ */
+void append_frame_record(std::span<const uint8_t> previous,
+                         std::span<const uint8_t> frame,
+                         std::vector<uint8_t> &out);
+
+/// XORs a record payload into `frame`. Returns false if it's malformed.
+bool apply_frame_payload(std::span<const uint8_t> payload,
+                         std::span<uint8_t> frame);
+
+/// Writes frames to a video file.
+class video_writer {
+public:
+  static std::optional<video_writer> create(const std::string &path,
+                                            uint16_t width, uint16_t height,
+                                            uint16_t keyframe_interval = 600);
+
+  video_writer(video_writer &&) = default;
+  ~video_writer();
+
+  void write_frame(std::span<const uint8_t> display);
+
+  /// Writes the index and trailer. Called by the destructor if necessary.
+  void close();
+
+  inline uint64_t frames() const { return m_frames; };
+
+private:
+  video_writer(std::ofstream out, uint16_t width, uint16_t height,
+               uint16_t keyframe_interval);
+
+  std::ofstream m_out;
+  uint16_t m_keyframe_interval;
+  uint64_t m_frames;
+  std::vector<uint8_t> m_previous;
+  std::vector<uint8_t> m_record;
+  std::vector<std::pair<uint64_t, uint64_t>> m_index;
+  bool m_closed;
+};
+
+/// Reads frames back from a video file.
+class video_reader {
+public:
+  static std::optional<video_reader> open(const std::string &path);
+
+  inline uint16_t width() const { return m_width; };
+  inline uint16_t height() const { return m_height; };
+  inline uint64_t frames() const { return m_frame_count; };
+  inline size_t display_size() const { return m_current.size(); };
+
+  /**
+   * Decodes frame `frame`, seeking through the nearest preceding keyframe if
+   * it's not the next frame in sequence. Returns an empty span if the frame
+   * doesn't exist or the file is corrupt.
+   */
+  std::span<const uint8_t> read(uint64_t frame);
+
+private:
+  video_reader(std::ifstream in, uint16_t width, uint16_t height);
+
+  bool decode_next();
+
+  std::ifstream m_in;
+  uint16_t m_width;
+  uint16_t m_height;
+  uint64_t m_frame_count;
+  /// Frame number held in m_current, or UINT64_MAX before the first.
+  uint64_t m_position;
+  std::vector<uint8_t> m_current;
+  std::vector<uint8_t> m_payload;
+  std::vector<std::pair<uint64_t, uint64_t>> m_index;
+};
+
+#endif // SWIMP_VIDEO_H
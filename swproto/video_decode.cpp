@@ -0,0 +1,45 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "video.hpp"
+
+/// Exports every frame of a recording as a binary PBM image.
+int main(int argc, char **argv) {
+  using namespace std;
+
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " <recording> <output prefix>\n";
+    return 1;
+  }
+
+  auto reader = video_reader::open(argv[1]);
+  if (!reader) {
+    cerr << "Failed to open " << argv[1] << '\n';
+    return 1;
+  }
+
+  for (uint64_t frame = 0; frame < reader->frames(); ++frame) {
+    auto display = reader->read(frame);
+    if (display.empty()) {
+      cerr << "Recording is corrupt at frame " << frame << '\n';
+      return 1;
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "%06llu.pbm",
+             static_cast<unsigned long long>(frame));
+    ofstream out(argv[2] + string(name), ios::binary);
+    // P4 packs pixels MSB-first like the CHIP-8 display, with 1 meaning black.
+    out << "P4\n" << reader->width() << ' ' << reader->height() << '\n';
+    out.write(reinterpret_cast<const char *>(display.data()), display.size());
+    if (!out) {
+      cerr << "Failed to write " << argv[2] << name << '\n';
+      return 1;
+    }
+  }
+
+  cout << "Wrote " << reader->frames() << " frames\n";
+  return 0;
+}
@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+#include "video.hpp"
+
+using frame = std::array<uint8_t, 256>;
+
+/// Frames that mostly differ by a few bytes, like real gameplay.
+static std::vector<frame> sample_frames(unsigned count) {
+  std::mt19937 rng(1234);
+  std::vector<frame> frames;
+  frame current{};
+  for (unsigned i = 0; i < count; ++i) {
+    for (unsigned changes = rng() % 4; changes; --changes) {
+      current[rng() % current.size()] ^= rng();
+    }
+    frames.push_back(current);
+  }
+  return frames;
+}
+
+static std::string temp_path(const char *name) {
+  return ::testing::TempDir() + name;
+}
+
+TEST(VideoTest, TestRoundTripAndSeek) {
+  auto frames = sample_frames(1000);
+  auto path = temp_path("roundtrip.c8v");
+  {
+    auto writer = video_writer::create(path, 64, 32, 100);
+    ASSERT_TRUE(writer);
+    for (auto &f : frames) {
+      writer->write_frame(f);
+    }
+  }
+
+  auto reader = video_reader::open(path);
+  ASSERT_TRUE(reader);
+  ASSERT_EQ(reader->frames(), frames.size());
+  ASSERT_EQ(reader->width(), 64);
+  ASSERT_EQ(reader->height(), 32);
+
+  // Sequential.
+  for (unsigned i = 0; i < frames.size(); ++i) {
+    auto decoded = reader->read(i);
+    ASSERT_TRUE(std::equal(decoded.begin(), decoded.end(), frames[i].begin(),
+                           frames[i].end()))
+        << "frame " << i;
+  }
+  // Random access, backwards and across keyframes.
+  for (unsigned i : {999u, 3u, 150u, 100u, 99u, 0u, 998u}) {
+    auto decoded = reader->read(i);
+    ASSERT_TRUE(std::equal(decoded.begin(), decoded.end(), frames[i].begin(),
+                           frames[i].end()))
+        << "frame " << i;
+  }
+  ASSERT_TRUE(reader->read(1000).empty());
+
+  // Mostly-identical frames should cost a handful of bytes each.
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  ASSERT_LT(file.tellg(), 16 * frames.size());
+  std::remove(path.c_str());
+}
+
+TEST(VideoTest, TestTruncatedRecording) {
+  auto frames = sample_frames(50);
+  auto path = temp_path("truncated.c8v");
+  {
+    auto writer = video_writer::create(path, 64, 32, 20);
+    ASSERT_TRUE(writer);
+    for (auto &f : frames) {
+      writer->write_frame(f);
+    }
+  }
+
+  // Chop off the index and trailer, as if the recorder had been killed.
+  std::vector<char> contents;
+  {
+    std::ifstream in(path, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(in), {});
+  }
+  contents.resize(contents.size() - 30);
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(contents.data(), contents.size());
+  }
+
+  auto reader = video_reader::open(path);
+  ASSERT_TRUE(reader);
+  ASSERT_GT(reader->frames(), 40);
+  ASSERT_LE(reader->frames(), 50);
+  auto last = reader->frames() - 1;
+  auto decoded = reader->read(last);
+  ASSERT_TRUE(std::equal(decoded.begin(), decoded.end(), frames[last].begin(),
+                         frames[last].end()));
+  std::remove(path.c_str());
+}